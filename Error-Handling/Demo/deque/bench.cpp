@@ -0,0 +1,197 @@
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "../vector/vector.hpp"
+#include "deque.hpp"
+#include "spsc_queue.hpp"
+
+namespace
+{
+
+/// Use a `vector` as a FIFO of `state.range(0)` elements: remove the first
+/// element with `erase(0)` and append one, which copies all the elements.
+void
+BM_fifo_vector(benchmark::State & state)
+{
+  const size_t length = static_cast<size_t>(state.range(0));
+
+  ywen::vector<uint64_t> fifo;
+  for (size_t i = 0; i < length; ++i)
+  {
+    fifo.push_back(i);
+  }
+
+  uint64_t next = length;
+  for (auto _ : state)
+  {
+    benchmark::DoNotOptimize(fifo[0]);
+    fifo.erase(0);
+    fifo.push_back(next++);
+  }
+
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+/// The same FIFO with a `deque`.
+void
+BM_fifo_deque(benchmark::State & state)
+{
+  const size_t length = static_cast<size_t>(state.range(0));
+
+  ywen::deque<uint64_t> fifo;
+  for (size_t i = 0; i < length; ++i)
+  {
+    fifo.push_back(i);
+  }
+
+  uint64_t next = length;
+  for (auto _ : state)
+  {
+    benchmark::DoNotOptimize(fifo.front());
+    fifo.pop_front();
+    fifo.push_back(next++);
+  }
+
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+/// The same FIFO with a `std::deque`, for comparison.
+void
+BM_fifo_std_deque(benchmark::State & state)
+{
+  const size_t length = static_cast<size_t>(state.range(0));
+
+  std::deque<uint64_t> fifo;
+  for (size_t i = 0; i < length; ++i)
+  {
+    fifo.push_back(i);
+  }
+
+  uint64_t next = length;
+  for (auto _ : state)
+  {
+    benchmark::DoNotOptimize(fifo.front());
+    fifo.pop_front();
+    fifo.push_back(next++);
+  }
+
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+/// The number of elements handed from one thread to another per iteration.
+constexpr size_t HANDOFF_COUNT = 1U << 20;
+
+/// Hand `HANDOFF_COUNT` elements from a producer thread to the calling
+/// thread through an `spsc_queue` of `state.range(0)` slots.
+void
+BM_handoff_spsc(benchmark::State & state)
+{
+  const size_t capacity = static_cast<size_t>(state.range(0));
+
+  for (auto _ : state)
+  {
+    ywen::spsc_queue<uint64_t> q(capacity);
+
+    std::thread producer([&q]() {
+      for (uint64_t i = 0; i < HANDOFF_COUNT; ++i)
+      {
+        while (!q.try_push(i))
+        {
+          std::this_thread::yield();
+        }
+      }
+    });
+
+    uint64_t value = 0;
+    for (size_t i = 0; i < HANDOFF_COUNT; ++i)
+    {
+      while (!q.try_pop(value))
+      {
+        std::this_thread::yield();
+      }
+    }
+    benchmark::DoNotOptimize(value);
+
+    producer.join();
+  }
+
+  state.SetItemsProcessed(
+    static_cast<int64_t>(state.iterations()) *
+    static_cast<int64_t>(HANDOFF_COUNT));
+}
+
+/// The same handoff through a `deque` that is guarded by a mutex, for
+/// comparison.
+void
+BM_handoff_mutex(benchmark::State & state)
+{
+  const size_t capacity = static_cast<size_t>(state.range(0));
+
+  for (auto _ : state)
+  {
+    std::mutex mutex;
+    ywen::deque<uint64_t> q;
+
+    std::thread producer([&mutex, &q, capacity]() {
+      for (uint64_t i = 0; i < HANDOFF_COUNT;)
+      {
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          if (q.size() < capacity)
+          {
+            q.push_back(i++);
+            continue;
+          }
+        }
+        std::this_thread::yield();
+      }
+    });
+
+    uint64_t value = 0;
+    for (size_t i = 0; i < HANDOFF_COUNT;)
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!q.empty())
+        {
+          value = q.front();
+          q.pop_front();
+          ++i;
+          continue;
+        }
+      }
+      std::this_thread::yield();
+    }
+    benchmark::DoNotOptimize(value);
+
+    producer.join();
+  }
+
+  state.SetItemsProcessed(
+    static_cast<int64_t>(state.iterations()) *
+    static_cast<int64_t>(HANDOFF_COUNT));
+}
+
+}  // namespace
+
+BENCHMARK(BM_fifo_vector)->RangeMultiplier(16)->Range(16, 64 << 10);
+BENCHMARK(BM_fifo_deque)->RangeMultiplier(16)->Range(16, 64 << 10);
+BENCHMARK(BM_fifo_std_deque)->RangeMultiplier(16)->Range(16, 64 << 10);
+
+BENCHMARK(BM_handoff_spsc)
+  ->Arg(64)
+  ->Arg(4096)
+  ->ArgName("capacity")
+  ->UseRealTime()
+  ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_handoff_mutex)
+  ->Arg(64)
+  ->Arg(4096)
+  ->ArgName("capacity")
+  ->UseRealTime()
+  ->Unit(benchmark::kMillisecond);
@@ -0,0 +1,454 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace ywen
+{
+
+/// A double-ended queue on a ring buffer. Like `vector`, it is mainly for
+/// study purpose and prefers exception safety over complexity, but unlike
+/// `vector::erase(0)`, which copies all the elements, adding and removing
+/// elements at both ends is O(1) (amortized when the buffer grows).
+///
+/// The elements are stored in an array whose capacity is a power of 2, from
+/// the slot `m_head` on, wrapping around at the end of the array, so the
+/// slot of the ith element is `(m_head + i) & (m_capacity - 1)`.
+///
+/// Some outstanding differences than the standard C++ deque:
+/// - No iterator.
+/// - No allocator.
+/// - Some member functions (e.g., `at`) do not throw exceptions.
+/// - The references to the elements are invalidated when the buffer grows.
+template<typename _Ty>
+class deque
+{
+public:
+  /// Construct an empty deque.
+  constexpr deque() noexcept;
+
+  /// Construct a deque using the initialization list.
+  ///
+  /// Throws:
+  /// - `std::bad_alloc`: When out of memory.
+  /// - Exceptions thrown by _Ty's copy assignment operator. This `deque` does
+  ///   not catch them so the `deque` users must deal with them.
+  deque(std::initializer_list<_Ty> init);
+
+  deque(deque const &) = delete;
+
+  deque &
+  operator=(deque const &) = delete;
+
+  ~deque() noexcept;
+
+  /// Append the given value to the end of the deque.
+  ///
+  /// Strong exception guarantee: if it throws, the deque is not changed.
+  ///
+  /// Throws:
+  /// - `std::bad_alloc`: When out of memory.
+  /// - Exceptions thrown by _Ty's copy assignment operator. This `deque` does
+  ///   not catch them so the `deque` users must deal with them.
+  void
+  push_back(_Ty const & value);
+
+  /// Prepend the given value to the beginning of the deque.
+  ///
+  /// Strong exception guarantee: if it throws, the deque is not changed.
+  ///
+  /// Throws: see `push_back`.
+  void
+  push_front(_Ty const & value);
+
+  /// Remove the last element of the deque. The deque must not be empty.
+  ///
+  /// Unless _Ty is trivially destructible, the slot of the element is
+  /// assigned `_Ty()`, so the resources that the element holds are released
+  /// right away.
+  ///
+  /// Strong exception guarantee: if it throws, the deque is not changed.
+  ///
+  /// Throws:
+  /// - Exceptions thrown by _Ty's default constructor and move assignment
+  ///   operator. This `deque` does not catch them so the `deque` users must
+  ///   deal with them.
+  void
+  pop_back();
+
+  /// Remove the first element of the deque. The deque must not be empty.
+  ///
+  /// Throws: see `pop_back`.
+  void
+  pop_front();
+
+  /// Exchange the elements (and the capacities) of this deque and `other`.
+  void
+  swap(deque & other) noexcept;
+
+  /// Get deque's size.
+  size_t
+  size() const noexcept;
+
+  /// Get deque's capacity, which is 0 or a power of 2.
+  size_t
+  capacity() const noexcept;
+
+  /// Check if the deque has no elements.
+  bool
+  empty() const noexcept;
+
+  /// Return the reference to the ith (0-based) element, with bounds checking.
+  _Ty &
+  at(const size_t i) noexcept;
+
+  /// Return the constant reference to the ith (0-based) element, with bounds
+  /// checking.
+  _Ty const &
+  at(const size_t i) const noexcept;
+
+  /// Return the reference to the ith (0-based) element, with bounds checking.
+  _Ty &
+  operator[](const size_t i) noexcept;
+
+  /// Return the constant reference to the ith (0-based) element, with bounds
+  /// checking.
+  _Ty const &
+  operator[](const size_t i) const noexcept;
+
+  /// Return the reference to the first element. The deque must not be empty.
+  _Ty &
+  front() noexcept;
+
+  _Ty const &
+  front() const noexcept;
+
+  /// Return the reference to the last element. The deque must not be empty.
+  _Ty &
+  back() noexcept;
+
+  _Ty const &
+  back() const noexcept;
+
+private:
+  /// Return the slot of the ith element.
+  size_t
+  _slot(const size_t i) const noexcept;
+
+  /// Release the resources of the element in `slot`, which is being removed.
+  void
+  _release(const size_t slot);
+
+  /// Make sure that there is room for one more element, moving the elements
+  /// to a bigger buffer if the buffer is full.
+  ///
+  /// Strong exception guarantee: if it throws, the deque is not changed.
+  void
+  _reserve_one();
+
+  /// Return the new capacity based on the given capacity.
+  static size_t
+  _get_new_capacity(const size_t capacity) noexcept;
+
+private:
+  /// The slot of the first element.
+  ///
+  /// Invariants:
+  /// - `0 == m_capacity || m_head < m_capacity`.
+  size_t m_head;
+
+  /// The current number of elements inside the deque.
+  ///
+  /// Invariants:
+  /// - `m_size <= m_capacity`.
+  size_t m_size;
+
+  /// The number of slots of the buffer.
+  ///
+  /// Invariants:
+  /// - `m_capacity` is 0 or a power of 2.
+  size_t m_capacity;
+
+  /// The raw pointer to the underlying buffer.
+  ///
+  /// Invariants:
+  /// - `0 == m_capacity && nullptr == m_vec`, OR
+  /// - `0 < m_capacity && nullptr != m_vec`.
+  _Ty * m_vec;
+};
+
+template<class _Ty>
+constexpr deque<_Ty>::deque() noexcept
+  : m_head(0), m_size(0), m_capacity(0), m_vec(nullptr)
+{
+  // Empty
+}
+
+template<class _Ty>
+deque<_Ty>::deque(std::initializer_list<_Ty> init)
+  : m_head(0), m_size(0), m_capacity(0), m_vec(nullptr)
+{
+  const size_t count = init.size();  // `size()` does not throw.
+  if (0 == count)
+  {
+    return;
+  }
+
+  size_t capacity = 1;
+  while (capacity < count)
+  {
+    capacity *= 2;
+  }
+
+  // `new` may throw `std::bad_alloc`
+  std::unique_ptr<_Ty[]> new_vec(new _Ty[capacity]);
+
+  size_t i = 0;
+  for (_Ty const & value : init)
+  {
+    // _Ty's copy assignment operator may throw.
+    new_vec[i] = value;
+    ++i;
+  }
+
+  m_vec = new_vec.release();  // `release()` does not throw.
+  m_size = count;
+  m_capacity = capacity;
+
+  assert((nullptr != m_vec));
+  assert((count == m_size));
+  assert((m_size <= m_capacity));
+}
+
+template<class _Ty>
+deque<_Ty>::~deque() noexcept
+{
+  // See `vector::~vector` about _Ty's destructor throwing.
+  if (m_vec != nullptr)
+  {
+    delete[] m_vec;
+    m_vec = nullptr;
+  }
+
+  m_head = 0;
+  m_size = 0;
+  m_capacity = 0;
+}
+
+template<class _Ty>
+void
+deque<_Ty>::push_back(_Ty const & value)
+{
+  const size_t prev_size = m_size;
+
+  // `_reserve_one()` may throw, in which case nothing is changed.
+  this->_reserve_one();
+
+  // The slot is beyond the elements, so if _Ty's copy assignment throws, the
+  // change is not observable. The bigger buffer, if any, holds the same
+  // elements, which is not observable either (except for the capacity).
+  m_vec[this->_slot(m_size)] = value;
+  ++m_size;
+
+  assert((prev_size + 1 == m_size));
+  assert((m_size <= m_capacity));
+}
+
+template<class _Ty>
+void
+deque<_Ty>::push_front(_Ty const & value)
+{
+  const size_t prev_size = m_size;
+
+  // `_reserve_one()` may throw, in which case nothing is changed.
+  this->_reserve_one();
+
+  // The slot before the first element (wrapping around) is free. See
+  // `push_back` about _Ty's copy assignment throwing.
+  const size_t new_head = (m_head + m_capacity - 1) & (m_capacity - 1);
+  m_vec[new_head] = value;
+  m_head = new_head;
+  ++m_size;
+
+  assert((prev_size + 1 == m_size));
+  assert((m_size <= m_capacity));
+}
+
+template<class _Ty>
+void
+deque<_Ty>::pop_back()
+{
+  assert((0U < m_size));
+
+  // If _Ty's default constructor or move assignment throws, the element is
+  // still there.
+  this->_release(this->_slot(m_size - 1));
+  --m_size;
+}
+
+template<class _Ty>
+void
+deque<_Ty>::pop_front()
+{
+  assert((0U < m_size));
+
+  // See `pop_back` about _Ty's default constructor or move assignment
+  // throwing.
+  this->_release(m_head);
+  m_head = (m_head + 1) & (m_capacity - 1);
+  --m_size;
+}
+
+template<class _Ty>
+void
+deque<_Ty>::swap(deque & other) noexcept
+{
+  std::swap(m_head, other.m_head);
+  std::swap(m_size, other.m_size);
+  std::swap(m_capacity, other.m_capacity);
+  std::swap(m_vec, other.m_vec);
+}
+
+template<class _Ty>
+size_t
+deque<_Ty>::size() const noexcept
+{
+  return m_size;
+}
+
+template<class _Ty>
+size_t
+deque<_Ty>::capacity() const noexcept
+{
+  return m_capacity;
+}
+
+template<class _Ty>
+bool
+deque<_Ty>::empty() const noexcept
+{
+  return 0 == m_size;
+}
+
+template<class _Ty>
+_Ty &
+deque<_Ty>::at(const size_t i) noexcept
+{
+  return const_cast<_Ty &>(static_cast<deque<_Ty> const *>(this)->at(i));
+}
+
+template<class _Ty>
+_Ty const &
+deque<_Ty>::at(const size_t i) const noexcept
+{
+  assert((i < m_size));
+
+  return m_vec[this->_slot(i)];
+}
+
+template<class _Ty>
+_Ty &
+deque<_Ty>::operator[](const size_t i) noexcept
+{
+  return this->at(i);
+}
+
+template<class _Ty>
+_Ty const &
+deque<_Ty>::operator[](const size_t i) const noexcept
+{
+  return this->at(i);
+}
+
+template<class _Ty>
+_Ty &
+deque<_Ty>::front() noexcept
+{
+  return this->at(0);
+}
+
+template<class _Ty>
+_Ty const &
+deque<_Ty>::front() const noexcept
+{
+  return this->at(0);
+}
+
+template<class _Ty>
+_Ty &
+deque<_Ty>::back() noexcept
+{
+  return this->at(m_size - 1);
+}
+
+template<class _Ty>
+_Ty const &
+deque<_Ty>::back() const noexcept
+{
+  return this->at(m_size - 1);
+}
+
+template<class _Ty>
+size_t
+deque<_Ty>::_slot(const size_t i) const noexcept
+{
+  return (m_head + i) & (m_capacity - 1);
+}
+
+template<class _Ty>
+void
+deque<_Ty>::_release(const size_t slot)
+{
+  if (!std::is_trivially_destructible<_Ty>::value)
+  {
+    m_vec[slot] = _Ty();
+  }
+}
+
+template<class _Ty>
+void
+deque<_Ty>::_reserve_one()
+{
+  if (m_size < m_capacity)
+  {
+    return;
+  }
+
+  const size_t new_capacity = _get_new_capacity(m_capacity);
+
+  // `new` may throw `std::bad_alloc`.
+  std::unique_ptr<_Ty[]> new_vec(new _Ty[new_capacity]);
+
+  // Copy the elements to the beginning of the new buffer, unwrapping them.
+  for (size_t i = 0; i < m_size; ++i)
+  {
+    // If _Ty's copy assignment throws, `new_vec` will de-allocate the
+    // temporary buffer so no resource leaks.
+    new_vec[i] = m_vec[this->_slot(i)];
+  }
+
+  _Ty * tmp_vec = new_vec.release();  // `release()` doesn't throw.
+  std::swap(tmp_vec, m_vec);          // `std::swap()` doesn't throw.
+
+  // See `vector::insert` about the destructor throwing.
+  delete[] tmp_vec;
+
+  m_head = 0;
+  m_capacity = new_capacity;
+
+  assert((nullptr != m_vec));
+  assert((m_size < m_capacity));
+}
+
+template<class _Ty>
+size_t
+deque<_Ty>::_get_new_capacity(const size_t capacity) noexcept
+{
+  return (0 == capacity ? 4 : capacity * 2);
+}
+
+}  // namespace ywen
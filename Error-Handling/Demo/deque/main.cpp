@@ -0,0 +1,258 @@
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "deque.hpp"
+#include "spsc_queue.hpp"
+
+using ywen::deque;
+using ywen::spsc_queue;
+
+namespace
+{
+
+/// An element whose copy assignment throws when `fail` is set.
+struct fragile
+{
+  static bool fail;
+
+  int value = 0;
+
+  fragile() = default;
+
+  fragile(int v) : value(v)
+  {
+    // Empty
+  }
+
+  fragile(fragile const &) = default;
+
+  fragile &
+  operator=(fragile const & other)
+  {
+    if (fail)
+    {
+      throw std::runtime_error("copy");
+    }
+    value = other.value;
+    return *this;
+  }
+
+  fragile &
+  operator=(fragile &&) = default;
+};
+
+bool fragile::fail = false;
+
+}  // namespace
+
+TEST(Test_ywen_deque, test_constructor)
+{
+  {
+    deque<int> d;
+
+    EXPECT_TRUE(d.empty());
+    EXPECT_EQ(0U, d.size());
+    EXPECT_EQ(0U, d.capacity());
+  }
+
+  {
+    deque<int> d = {3, 2, 1};
+
+    EXPECT_EQ(3U, d.size());
+    EXPECT_EQ(4U, d.capacity());
+    EXPECT_EQ(3, d.front());
+    EXPECT_EQ(1, d.back());
+    EXPECT_EQ(2, d[1]);
+  }
+}
+
+TEST(Test_ywen_deque, test_push_pop)
+{
+  deque<int> d;
+
+  d.push_back(2);
+  d.push_front(1);
+  d.push_back(3);
+  d.push_front(0);
+  ASSERT_EQ(4U, d.size());
+  for (size_t i = 0; i < d.size(); ++i)
+  {
+    EXPECT_EQ(static_cast<int>(i), d.at(i));
+  }
+
+  d.pop_front();
+  EXPECT_EQ(1, d.front());
+  d.pop_back();
+  EXPECT_EQ(2, d.back());
+  d.pop_back();
+  d.pop_front();
+  EXPECT_TRUE(d.empty());
+}
+
+TEST(Test_ywen_deque, test_fifo)
+{
+  // Use the deque as a FIFO whose elements wrap around the end of the
+  // buffer many times, and which grows while they wrap around.
+  deque<std::string> d;
+
+  size_t pushed = 0;
+  size_t popped = 0;
+  for (size_t round = 0; round < 100; ++round)
+  {
+    for (size_t i = 0; i < round % 7 + 1; ++i)
+    {
+      d.push_back(std::to_string(pushed++));
+    }
+    for (size_t i = 0; i < round % 5 + 1 && !d.empty(); ++i)
+    {
+      EXPECT_EQ(std::to_string(popped++), d.front());
+      d.pop_front();
+    }
+
+    ASSERT_EQ(pushed - popped, d.size());
+    EXPECT_LE(d.size(), d.capacity());
+    EXPECT_EQ(0U, d.capacity() & (d.capacity() - 1));
+  }
+
+  // The same with the other end.
+  deque<int> r;
+  for (int i = 0; i < 1000; ++i)
+  {
+    r.push_front(i);
+    if (i % 3 == 0)
+    {
+      EXPECT_EQ(i / 3, r.back());
+      r.pop_back();
+    }
+  }
+  EXPECT_EQ(666U, r.size());
+  EXPECT_EQ(999, r.front());
+}
+
+TEST(Test_ywen_deque, test_pop_releases)
+{
+  deque<std::shared_ptr<int>> d;
+  std::shared_ptr<int> p = std::make_shared<int>(1);
+
+  d.push_back(p);
+  d.push_front(p);
+  EXPECT_EQ(3, p.use_count());
+
+  d.pop_front();
+  d.pop_back();
+  EXPECT_EQ(1, p.use_count());
+}
+
+TEST(Test_ywen_deque, test_exception_safety)
+{
+  deque<fragile> d;
+  for (int i = 0; i < 4; ++i)
+  {
+    d.push_back(i);
+  }
+  d.pop_front();
+  d.push_back(4);  // Wraps around.
+  ASSERT_EQ(4U, d.capacity());
+
+  // Strong guarantee when the buffer is full (and has to grow), and when it
+  // isn't.
+  for (int round = 0; round < 2; ++round)
+  {
+    const size_t capacity = d.capacity();
+
+    fragile::fail = true;
+    EXPECT_THROW(d.push_back(9), std::runtime_error);
+    EXPECT_THROW(d.push_front(9), std::runtime_error);
+    fragile::fail = false;
+
+    ASSERT_EQ(4U, d.size());
+    EXPECT_EQ(capacity, d.capacity());
+    for (size_t i = 0; i < d.size(); ++i)
+    {
+      EXPECT_EQ(static_cast<int>(i + 1), d[i].value);
+    }
+
+    d.push_back(5);
+    d.pop_back();
+  }
+}
+
+TEST(Test_ywen_spsc_queue, test_single_thread)
+{
+  spsc_queue<int> q(4);
+  EXPECT_EQ(4U, q.capacity());
+
+  int value = 0;
+  EXPECT_FALSE(q.try_pop(value));
+
+  for (int round = 0; round < 3; ++round)
+  {
+    for (int i = 0; i < 4; ++i)
+    {
+      EXPECT_TRUE(q.try_push(i));
+    }
+    EXPECT_FALSE(q.try_push(4));
+    EXPECT_EQ(4U, q.size());
+
+    for (int i = 0; i < 4; ++i)
+    {
+      EXPECT_TRUE(q.try_pop(value));
+      EXPECT_EQ(i, value);
+    }
+    EXPECT_FALSE(q.try_pop(value));
+  }
+}
+
+TEST(Test_ywen_spsc_queue, test_exception_safety)
+{
+  spsc_queue<fragile> q(2);
+  fragile value;
+
+  fragile::fail = true;
+  EXPECT_THROW(q.try_push(fragile(1)), std::runtime_error);
+  fragile::fail = false;
+  EXPECT_EQ(0U, q.size());
+
+  ASSERT_TRUE(q.try_push(fragile(1)));
+  fragile::fail = true;
+  EXPECT_THROW(q.try_pop(value), std::runtime_error);
+  fragile::fail = false;
+  EXPECT_EQ(1U, q.size());
+
+  ASSERT_TRUE(q.try_pop(value));
+  EXPECT_EQ(1, value.value);
+}
+
+TEST(Test_ywen_spsc_queue, test_two_threads)
+{
+  const size_t COUNT = 200000;
+  spsc_queue<size_t> q(64);
+
+  std::thread producer([&q, COUNT]() {
+    for (size_t i = 0; i < COUNT; ++i)
+    {
+      while (!q.try_push(i))
+      {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  size_t value = 0;
+  for (size_t i = 0; i < COUNT; ++i)
+  {
+    while (!q.try_pop(value))
+    {
+      std::this_thread::yield();
+    }
+    EXPECT_EQ(i, value);
+  }
+
+  producer.join();
+  EXPECT_EQ(0U, q.size());
+}
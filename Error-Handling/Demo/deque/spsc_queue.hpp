@@ -0,0 +1,153 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+
+namespace ywen
+{
+
+/// A bounded single-producer/single-consumer queue on a ring buffer, for
+/// handing elements from one thread to another without locks.
+///
+/// Only one thread may call `try_push` and only one (other) thread may call
+/// `try_pop` at the same time. The producer owns the slots from the tail to
+/// the head (the free slots) and the consumer owns the slots from the head
+/// to the tail (the elements); each of them publishes its progress with a
+/// release store of its own index, which the other loads with acquire.
+/// Each side also keeps a cached copy of the other side's index, so the
+/// shared cache line is only read when the cached copy says the queue is
+/// full (or empty).
+template<typename _Ty>
+class spsc_queue
+{
+public:
+  /// Construct a queue that holds up to `capacity` elements, which must be
+  /// a power of 2.
+  ///
+  /// Throws:
+  /// - `std::bad_alloc`: When out of memory.
+  explicit spsc_queue(size_t capacity);
+
+  spsc_queue(spsc_queue const &) = delete;
+
+  spsc_queue &
+  operator=(spsc_queue const &) = delete;
+
+  /// Append a copy of `value`. Returns false if the queue is full. Must be
+  /// called by the producer.
+  ///
+  /// Strong exception guarantee: if it throws, the queue is not changed.
+  ///
+  /// Throws:
+  /// - Exceptions thrown by _Ty's copy assignment operator.
+  bool
+  try_push(_Ty const & value);
+
+  /// Copy the first element to `value` and remove it. Returns false if the
+  /// queue is empty. Must be called by the consumer.
+  ///
+  /// Strong exception guarantee: if it throws, the queue is not changed (but
+  /// `value` may be).
+  ///
+  /// Throws:
+  /// - Exceptions thrown by _Ty's copy assignment operator.
+  bool
+  try_pop(_Ty & value);
+
+  /// Return the number of elements. It's exact only when neither side is
+  /// running.
+  size_t
+  size() const noexcept;
+
+  size_t
+  capacity() const noexcept;
+
+private:
+  const size_t m_capacity;
+  std::unique_ptr<_Ty[]> m_vec;
+
+  /// The index of the next element to pop, which only increases (the slot is
+  /// `m_head & (m_capacity - 1)`). It's written by the consumer.
+  alignas(64) std::atomic<size_t> m_head;
+
+  /// The consumer's copy of `m_tail`.
+  size_t m_tail_cache;
+
+  /// The index of the next slot to push. It's written by the producer.
+  alignas(64) std::atomic<size_t> m_tail;
+
+  /// The producer's copy of `m_head`.
+  size_t m_head_cache;
+};
+
+template<class _Ty>
+spsc_queue<_Ty>::spsc_queue(size_t capacity)
+  : m_capacity(capacity),
+    m_vec(new _Ty[capacity]),
+    m_head(0),
+    m_tail_cache(0),
+    m_tail(0),
+    m_head_cache(0)
+{
+  assert((capacity > 0 && 0 == (capacity & (capacity - 1))));
+}
+
+template<class _Ty>
+bool
+spsc_queue<_Ty>::try_push(_Ty const & value)
+{
+  const size_t tail = m_tail.load(std::memory_order_relaxed);
+  if (tail - m_head_cache == m_capacity)
+  {
+    m_head_cache = m_head.load(std::memory_order_acquire);
+    if (tail - m_head_cache == m_capacity)
+    {
+      return false;
+    }
+  }
+
+  // The slot is free, so if _Ty's copy assignment throws, the change is not
+  // observable.
+  m_vec[tail & (m_capacity - 1)] = value;
+  m_tail.store(tail + 1, std::memory_order_release);
+  return true;
+}
+
+template<class _Ty>
+bool
+spsc_queue<_Ty>::try_pop(_Ty & value)
+{
+  const size_t head = m_head.load(std::memory_order_relaxed);
+  if (head == m_tail_cache)
+  {
+    m_tail_cache = m_tail.load(std::memory_order_acquire);
+    if (head == m_tail_cache)
+    {
+      return false;
+    }
+  }
+
+  // If _Ty's copy assignment throws, the element is still there.
+  value = m_vec[head & (m_capacity - 1)];
+  m_head.store(head + 1, std::memory_order_release);
+  return true;
+}
+
+template<class _Ty>
+size_t
+spsc_queue<_Ty>::size() const noexcept
+{
+  return m_tail.load(std::memory_order_acquire) -
+         m_head.load(std::memory_order_acquire);
+}
+
+template<class _Ty>
+size_t
+spsc_queue<_Ty>::capacity() const noexcept
+{
+  return m_capacity;
+}
+
+}  // namespace ywen
@@ -0,0 +1,702 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "file.hpp"
+#include "codec.hpp"
+#include "compressed_file.hpp"
+#include "file_batch.hpp"
+#include "file_reader.hpp"
+#include "vector_io.hpp"
+
+using ywen::file;
+
+namespace
+{
+
+/// Return the path of a benchmark file in `$TMPDIR` (or `/tmp`).
+std::string
+bench_path(std::string const & name)
+{
+  const char * dir = std::getenv("TMPDIR");
+  return std::string(dir ? dir : "/tmp") + "/ywen_file_bench_" + name;
+}
+
+/// The source files shared by the benchmarks, keyed by size. They are
+/// created on the first use and removed when the benchmark program exits.
+class source_files
+{
+public:
+  ~source_files()
+  {
+    for (auto const & entry : m_fpaths)
+    {
+      std::remove(entry.second.c_str());
+    }
+  }
+
+  std::string const &
+  get(size_t size)
+  {
+    auto it = m_fpaths.find(size);
+    if (it != m_fpaths.end())
+    {
+      return it->second;
+    }
+
+    const std::string fpath = bench_path("src_" + std::to_string(size));
+
+    std::vector<char> chunk(1U << 20);
+    for (size_t i = 0; i < chunk.size(); ++i)
+    {
+      chunk[i] = static_cast<char>(i * 31 + 7);
+    }
+
+    file f(fpath);
+    f.open_write();
+    for (size_t written = 0; written < size; written += chunk.size())
+    {
+      f.write(chunk.data(), std::min(chunk.size(), size - written));
+    }
+
+    return m_fpaths.emplace(size, fpath).first->second;
+  }
+
+private:
+  std::map<size_t, std::string> m_fpaths;
+};
+
+source_files g_source_files;
+
+/// Copy a whole file with `file::copy_to`.
+///
+/// Arguments:
+/// - 0: The file size in bytes.
+/// - 1: The `ywen::copy_method` to start with.
+void
+BM_copy_to(benchmark::State & state)
+{
+  const size_t size = static_cast<size_t>(state.range(0));
+  const auto method = static_cast<ywen::copy_method>(state.range(1));
+
+  std::string const & src_fpath = g_source_files.get(size);
+  const std::string dst_fpath = bench_path("copy_dst");
+
+  for (auto _ : state)
+  {
+    state.PauseTiming();
+    file src(src_fpath);
+    src.open_read();
+    file dst(dst_fpath);
+    dst.open_write();
+    state.ResumeTiming();
+
+    benchmark::DoNotOptimize(src.copy_to(dst, 0, size, method));
+  }
+
+  state.SetBytesProcessed(
+    static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(size));
+
+  std::remove(dst_fpath.c_str());
+}
+
+/// Write a file in 1 MiB chunks and flush it to the disk.
+///
+/// Arguments:
+/// - 0: The file size in bytes.
+/// - 1: 1 to pass the size to `file::open_write` to allocate the file up
+///   front, 0 to let it grow as it's written.
+void
+BM_write_output(benchmark::State & state)
+{
+  const size_t size = static_cast<size_t>(state.range(0));
+  const bool preallocate = (state.range(1) != 0);
+  const std::string fpath = bench_path("output");
+
+  std::vector<char> chunk(1U << 20);
+  for (size_t i = 0; i < chunk.size(); ++i)
+  {
+    chunk[i] = static_cast<char>(i * 31 + 7);
+  }
+
+  for (auto _ : state)
+  {
+    file f(fpath);
+    f.open_write(preallocate ? size : 0);
+    for (size_t written = 0; written < size; written += chunk.size())
+    {
+      f.write(chunk.data(), std::min(chunk.size(), size - written));
+    }
+
+    // Without the flush, the blocks are allocated only later, when the page
+    // cache writes the data back. `file` doesn't expose its descriptor, but
+    // any descriptor of the file flushes all of its data.
+    const int fd = ::open(fpath.c_str(), O_RDONLY);
+    ::fdatasync(fd);
+    ::close(fd);
+
+    f.close();
+  }
+
+  state.SetBytesProcessed(
+    static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(size));
+
+  std::remove(fpath.c_str());
+}
+
+/// The directory probe: open a set of files of which some don't exist.
+class probe_files
+{
+public:
+  /// The number of paths in a probe.
+  static constexpr size_t COUNT = 100;
+
+  probe_files()
+  {
+    for (size_t i = 0; i < COUNT; ++i)
+    {
+      m_fpaths.push_back(bench_path("probe_" + std::to_string(i)));
+      file f(m_fpaths.back());
+      f.open_write();
+    }
+  }
+
+  ~probe_files()
+  {
+    for (std::string const & fpath : m_fpaths)
+    {
+      std::remove(fpath.c_str());
+    }
+  }
+
+  /// Return the paths to probe, `miss_percent` percent of which (evenly
+  /// spread) don't exist.
+  std::vector<std::string>
+  get(size_t miss_percent) const
+  {
+    std::vector<std::string> fpaths = m_fpaths;
+    for (size_t i = 0; i < COUNT; ++i)
+    {
+      if ((i * miss_percent) % 100 + miss_percent >= 100)
+      {
+        fpaths[i] += ".missing";
+      }
+    }
+    return fpaths;
+  }
+
+private:
+  std::vector<std::string> m_fpaths;
+};
+
+/// Probe the files with the throwing `file::open_read`.
+///
+/// Arguments:
+/// - 0: The percentage of the files that don't exist.
+void
+BM_probe_throwing(benchmark::State & state)
+{
+  static const probe_files probe;
+  const std::vector<std::string> fpaths =
+    probe.get(static_cast<size_t>(state.range(0)));
+
+  size_t found = 0;
+  for (auto _ : state)
+  {
+    for (std::string const & fpath : fpaths)
+    {
+      file f(fpath);
+      try
+      {
+        f.open_read();
+        ++found;
+      }
+      catch (ywen::file_open_error const &)
+      {
+        // Not found.
+      }
+    }
+  }
+
+  benchmark::DoNotOptimize(found);
+  state.SetItemsProcessed(
+    static_cast<int64_t>(state.iterations()) *
+    static_cast<int64_t>(fpaths.size()));
+}
+
+/// Probe the files with the non-throwing `file::try_open_read`.
+///
+/// Arguments:
+/// - 0: The percentage of the files that don't exist.
+void
+BM_probe_non_throwing(benchmark::State & state)
+{
+  static const probe_files probe;
+  const std::vector<std::string> fpaths =
+    probe.get(static_cast<size_t>(state.range(0)));
+
+  size_t found = 0;
+  for (auto _ : state)
+  {
+    for (std::string const & fpath : fpaths)
+    {
+      file f(fpath);
+      if (f.try_open_read())
+      {
+        ++found;
+      }
+    }
+  }
+
+  benchmark::DoNotOptimize(found);
+  state.SetItemsProcessed(
+    static_cast<int64_t>(state.iterations()) *
+    static_cast<int64_t>(fpaths.size()));
+}
+
+/// Drop `fpath` from the page cache, so the next read goes to the disk.
+void
+drop_cache(std::string const & fpath)
+{
+  const int fd = ::open(fpath.c_str(), O_RDONLY);
+  if (fd >= 0)
+  {
+    // Dirty pages can't be dropped.
+    ::fdatasync(fd);
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    ::close(fd);
+  }
+}
+
+/// The small files of the batch benchmarks: `COUNT` files of `SIZE` bytes.
+class batch_files
+{
+public:
+  static constexpr size_t COUNT = 10000;
+  static constexpr size_t SIZE = 4096;
+
+  batch_files()
+  {
+    const std::vector<char> data(SIZE, 'x');
+    for (size_t i = 0; i < COUNT; ++i)
+    {
+      m_fpaths.push_back(bench_path("batch_" + std::to_string(i)));
+      file f(m_fpaths.back());
+      f.open_write();
+      f.write(data.data(), data.size());
+    }
+  }
+
+  ~batch_files()
+  {
+    for (std::string const & fpath : m_fpaths)
+    {
+      std::remove(fpath.c_str());
+    }
+  }
+
+  std::vector<std::string> const &
+  fpaths() const noexcept
+  {
+    return m_fpaths;
+  }
+
+  /// Drop the files from the page cache, so the next read goes to the disk.
+  void
+  drop_cache() const
+  {
+    for (std::string const & fpath : m_fpaths)
+    {
+      ::drop_cache(fpath);
+    }
+  }
+
+private:
+  std::vector<std::string> m_fpaths;
+};
+
+/// Load `batch_files` with `file_batch`.
+///
+/// Arguments:
+/// - 0: The number of worker threads; 0 reads the files one by one on the
+///   calling thread.
+/// - 1: 1 to drop the files from the page cache before every load (cold
+///   cache), 0 to keep them cached (warm cache).
+void
+BM_file_batch(benchmark::State & state)
+{
+  static const batch_files files;
+  const size_t threads = static_cast<size_t>(state.range(0));
+  const bool cold = (state.range(1) != 0);
+
+  ywen::thread_pool pool(threads);
+  ywen::file_batch batch(files.fpaths());
+
+  for (auto _ : state)
+  {
+    if (cold)
+    {
+      state.PauseTiming();
+      files.drop_cache();
+      state.ResumeTiming();
+    }
+
+    batch.read_all(pool);
+  }
+
+  benchmark::DoNotOptimize(batch.arena_size());
+  state.SetItemsProcessed(
+    static_cast<int64_t>(state.iterations()) *
+    static_cast<int64_t>(batch_files::COUNT));
+  state.SetBytesProcessed(
+    static_cast<int64_t>(state.iterations()) *
+    static_cast<int64_t>(batch_files::COUNT * batch_files::SIZE));
+}
+
+/// Simulate the processing of a chunk that costs about as much CPU time as
+/// reading it from the page cache.
+uint64_t
+process(char const * data, size_t size)
+{
+  uint64_t h = 14695981039346656037ULL;
+  for (size_t i = 0; i < size; ++i)
+  {
+    h = (h ^ static_cast<unsigned char>(data[i])) * 1099511628211ULL;
+  }
+  return h;
+}
+
+/// Scan and process a 256 MiB file.
+///
+/// Arguments:
+/// - 0: The number of buffers of `file_reader`; 0 reads and processes the
+///   buffers one after another on the calling thread.
+/// - 1: The buffer size in bytes.
+/// - 2: 1 to drop the file from the page cache before every scan (cold
+///   cache), 0 to keep it cached (warm cache).
+void
+BM_scan(benchmark::State & state)
+{
+  const size_t SIZE = 256U << 20;
+  const size_t buffer_count = static_cast<size_t>(state.range(0));
+  const size_t buffer_size = static_cast<size_t>(state.range(1));
+  const bool cold = (state.range(2) != 0);
+
+  std::string const & fpath = g_source_files.get(SIZE);
+  file f(fpath);
+  f.open_read();
+
+  std::vector<char> buf(0 == buffer_count ? buffer_size : 0);
+  uint64_t h = 0;
+
+  for (auto _ : state)
+  {
+    if (cold)
+    {
+      state.PauseTiming();
+      drop_cache(fpath);
+      state.ResumeTiming();
+    }
+
+    if (0 == buffer_count)
+    {
+      off_t offset = 0;
+      for (size_t n = f.pread(buf.data(), buf.size(), offset); n > 0;
+           n = f.pread(buf.data(), buf.size(), offset))
+      {
+        h += process(buf.data(), n);
+        offset += static_cast<off_t>(n);
+      }
+    }
+    else
+    {
+      ywen::file_reader reader(f, buffer_count, buffer_size);
+      for (std::string_view chunk = reader.next(); !chunk.empty();
+           chunk = reader.next())
+      {
+        h += process(chunk.data(), chunk.size());
+      }
+    }
+  }
+
+  benchmark::DoNotOptimize(h);
+  state.SetBytesProcessed(
+    static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(SIZE));
+}
+
+/// Read a 256 MiB vector in the checksummed block format.
+///
+/// Arguments:
+/// - 0: The number of worker threads that check the blocks; -1 checks them
+///   on the calling thread without a thread pool.
+void
+BM_read_vector(benchmark::State & state)
+{
+  const size_t COUNT = (256U << 20) / sizeof(uint64_t);
+  const std::string fpath = bench_path("vector_io");
+
+  {
+    ywen::vector<uint64_t> v;
+    v.resize(COUNT);
+    for (size_t i = 0; i < COUNT; ++i)
+    {
+      v[i] = i * 0x9e3779b97f4a7c15ULL;
+    }
+
+    file f(fpath);
+    f.open_write();
+    ywen::write_vector(f, v);
+  }
+
+  std::unique_ptr<ywen::thread_pool> pool;
+  if (state.range(0) >= 0)
+  {
+    pool.reset(new ywen::thread_pool(static_cast<size_t>(state.range(0))));
+  }
+
+  file f(fpath);
+  f.open_read();
+  ywen::vector<uint64_t> v;
+
+  for (auto _ : state)
+  {
+    ywen::read_vector(f, v, pool.get());
+  }
+
+  state.SetBytesProcessed(
+    static_cast<int64_t>(state.iterations()) *
+    static_cast<int64_t>(COUNT * sizeof(uint64_t)));
+
+  std::remove(fpath.c_str());
+}
+
+/// 256 MiB of log-like text that `lz_codec` compresses about 2.5x.
+std::vector<char> const &
+log_text()
+{
+  static const std::vector<char> text = []() {
+    static char const * const LEVELS[] = {"INFO", "WARN", "DEBUG", "ERROR"};
+    static char const * const WORDS[] = {
+      "opened", "closed", "read", "wrote", "file", "block", "cache", "miss"};
+
+    std::mt19937 rng(1);
+    std::vector<char> t;
+    t.reserve((256U << 20) + 256);
+    char line[256];
+    while (t.size() < (256U << 20))
+    {
+      const int n = std::snprintf(
+        line,
+        sizeof(line),
+        "2024-01-%02u 12:%02u:%02u %s worker-%u %s %s %u\n",
+        static_cast<unsigned>(rng() % 28 + 1),
+        static_cast<unsigned>(rng() % 60),
+        static_cast<unsigned>(rng() % 60),
+        LEVELS[rng() % 4],
+        static_cast<unsigned>(rng() % 16),
+        WORDS[rng() % 8],
+        WORDS[rng() % 8],
+        static_cast<unsigned>(rng() % 100000));
+      t.insert(t.end(), line, line + n);
+    }
+    t.resize(256U << 20);
+    return t;
+  }();
+
+  return text;
+}
+
+/// Write `log_text()` compressed, or as it is for comparison.
+///
+/// Arguments:
+/// - 0: The number of worker threads that compress; -1 writes the data as it
+///   is with `file::write`, and -2 compresses on the calling thread without
+///   a thread pool.
+void
+BM_compressed_write(benchmark::State & state)
+{
+  std::vector<char> const & text = log_text();
+  const std::string fpath = bench_path("compressed");
+  const int64_t threads = state.range(0);
+
+  std::unique_ptr<ywen::thread_pool> pool;
+  if (threads >= 0)
+  {
+    pool.reset(new ywen::thread_pool(static_cast<size_t>(threads)));
+  }
+  ywen::lz_codec lz;
+
+  for (auto _ : state)
+  {
+    file f(fpath);
+    f.open_write();
+
+    if (-1 == threads)
+    {
+      f.write(text.data(), text.size());
+    }
+    else
+    {
+      ywen::compressed_writer writer(
+        f, lz, ywen::DEFAULT_COMPRESSED_BLOCK_SIZE, pool.get());
+      writer.write(text.data(), text.size());
+      writer.finish();
+    }
+
+    state.PauseTiming();
+    state.counters["ratio"] =
+      static_cast<double>(text.size()) / static_cast<double>(f.size());
+    f.close();
+    state.ResumeTiming();
+  }
+
+  state.SetBytesProcessed(
+    static_cast<int64_t>(state.iterations()) *
+    static_cast<int64_t>(text.size()));
+
+  std::remove(fpath.c_str());
+}
+
+/// Read `log_text()` back from a compressed file, or from a plain file for
+/// comparison.
+///
+/// Arguments:
+/// - 0: See `BM_compressed_write`.
+/// - 1: 1 to drop the file from the page cache before every read (cold
+///   cache), 0 to keep it cached (warm cache).
+void
+BM_compressed_read(benchmark::State & state)
+{
+  std::vector<char> const & text = log_text();
+  const std::string fpath = bench_path("compressed");
+  const int64_t threads = state.range(0);
+  const bool cold = (state.range(1) != 0);
+
+  std::unique_ptr<ywen::thread_pool> pool;
+  if (threads >= 0)
+  {
+    pool.reset(new ywen::thread_pool(static_cast<size_t>(threads)));
+  }
+  ywen::lz_codec lz;
+
+  {
+    file f(fpath);
+    f.open_write();
+    if (-1 == threads)
+    {
+      f.write(text.data(), text.size());
+    }
+    else
+    {
+      ywen::compressed_writer writer(f, lz);
+      writer.write(text.data(), text.size());
+      writer.finish();
+    }
+  }
+
+  std::vector<char> buf(text.size());
+  file f(fpath);
+  f.open_read();
+
+  for (auto _ : state)
+  {
+    if (cold)
+    {
+      state.PauseTiming();
+      drop_cache(fpath);
+      state.ResumeTiming();
+    }
+
+    if (-1 == threads)
+    {
+      benchmark::DoNotOptimize(f.pread(buf.data(), buf.size(), 0));
+    }
+    else
+    {
+      ywen::compressed_reader reader(f, lz);
+      benchmark::DoNotOptimize(
+        reader.pread(buf.data(), buf.size(), 0, pool.get()));
+    }
+  }
+
+  state.SetBytesProcessed(
+    static_cast<int64_t>(state.iterations()) *
+    static_cast<int64_t>(text.size()));
+
+  std::remove(fpath.c_str());
+}
+
+void
+miss_percents(benchmark::internal::Benchmark * b)
+{
+  for (int64_t miss_percent : {0, 1, 10, 25, 50, 75, 90, 99, 100})
+  {
+    b->Arg(miss_percent);
+  }
+}
+
+}  // namespace
+
+BENCHMARK(BM_probe_throwing)
+  ->Apply(miss_percents)
+  ->ArgName("miss_percent");
+BENCHMARK(BM_probe_non_throwing)
+  ->Apply(miss_percents)
+  ->ArgName("miss_percent");
+
+BENCHMARK(BM_file_batch)
+  ->ArgsProduct({{0, 1, 3, 7, 15}, {0, 1}})
+  ->ArgNames({"threads", "cold"})
+  ->UseRealTime();
+
+BENCHMARK(BM_scan)
+  ->ArgsProduct({{0, 1, 2, 4, 8}, {64 << 10, 1 << 20}, {0, 1}})
+  ->ArgNames({"buffers", "buffer_size", "cold"})
+  ->UseRealTime();
+
+BENCHMARK(BM_read_vector)
+  ->DenseRange(-1, 3)
+  ->ArgName("threads")
+  ->UseRealTime();
+
+BENCHMARK(BM_compressed_write)
+  ->Arg(-1)
+  ->Arg(-2)
+  ->DenseRange(0, 3)
+  ->ArgName("threads")
+  ->UseRealTime();
+BENCHMARK(BM_compressed_read)
+  ->ArgsProduct({{-1, -2, 0, 1, 3}, {0, 1}})
+  ->ArgNames({"threads", "cold"})
+  ->UseRealTime();
+
+BENCHMARK(BM_write_output)
+  ->ArgsProduct({{1LL << 30, 4LL << 30}, {0, 1}})
+  ->ArgNames({"bytes", "preallocate"})
+  ->Unit(benchmark::kMillisecond)
+  ->UseRealTime();
+
+BENCHMARK(BM_copy_to)
+  ->ArgsProduct({
+    {64LL << 20, 1LL << 30, 4LL << 30},
+    {
+      static_cast<int64_t>(ywen::copy_method::reflink),
+      static_cast<int64_t>(ywen::copy_method::copy_file_range),
+      static_cast<int64_t>(ywen::copy_method::sendfile),
+      static_cast<int64_t>(ywen::copy_method::buffered),
+    },
+  })
+  ->ArgNames({"bytes", "method"})
+  ->Unit(benchmark::kMillisecond)
+  ->UseRealTime();
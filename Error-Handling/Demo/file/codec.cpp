@@ -0,0 +1,367 @@
+#include <cstddef>
+#include <cstring>
+
+#include "codec.hpp"
+
+namespace ywen
+{
+
+namespace
+{
+
+constexpr uint32_t NULL_CODEC_ID = 0;
+constexpr uint32_t LZ_CODEC_ID = 1;
+
+/// The shortest match.
+constexpr size_t MIN_MATCH = 4;
+
+/// The number of bytes at the end of the input that are always literals, so
+/// the match search can read 8 bytes at a time without checking the end.
+constexpr size_t LAST_LITERALS = 8;
+
+/// The farthest match, limited by the 2-byte offset.
+constexpr size_t MAX_OFFSET = 65535;
+
+/// The decompressor copies short literals in chunks of this many bytes when
+/// the buffers have room for them.
+constexpr ptrdiff_t COPY_SLACK = 16;
+
+/// The hash table has `1 << HASH_BITS` entries.
+constexpr int HASH_BITS = 12;
+
+/// Skip ahead one more byte after every `1 << SKIP_SHIFT` failed searches.
+constexpr int SKIP_SHIFT = 6;
+
+uint32_t
+read32(unsigned char const * p) noexcept
+{
+  uint32_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+uint64_t
+read64(unsigned char const * p) noexcept
+{
+  uint64_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+uint32_t
+hash(uint32_t seq) noexcept
+{
+  return (seq * 2654435761U) >> (32 - HASH_BITS);
+}
+
+/// Return the number of bytes that match at `p` and `ref`, up to `limit`.
+size_t
+match_length(
+  unsigned char const * p,
+  unsigned char const * ref,
+  unsigned char const * limit) noexcept
+{
+  unsigned char const * const start = p;
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  while (p + 8 <= limit)
+  {
+    const uint64_t diff = read64(p) ^ read64(ref);
+    if (diff != 0)
+    {
+      return static_cast<size_t>(p - start) + (__builtin_ctzll(diff) >> 3);
+    }
+    p += 8;
+    ref += 8;
+  }
+#endif
+
+  while (p < limit && *p == *ref)
+  {
+    ++p;
+    ++ref;
+  }
+
+  return static_cast<size_t>(p - start);
+}
+
+/// Write the extra bytes of a length field whose 4 bits hold 15.
+unsigned char *
+write_length(unsigned char * op, size_t length) noexcept
+{
+  for (; length >= 255; length -= 255)
+  {
+    *op++ = 255;
+  }
+  *op++ = static_cast<unsigned char>(length);
+  return op;
+}
+
+/// Write a sequence. `offset` is 0 for the last sequence, which has no
+/// match.
+unsigned char *
+write_sequence(
+  unsigned char * op,
+  unsigned char const * literals,
+  size_t literal_length,
+  size_t offset,
+  size_t match_length) noexcept
+{
+  unsigned char * token = op++;
+
+  const size_t ll = (literal_length < 15 ? literal_length : 15);
+  if (15 == ll)
+  {
+    op = write_length(op, literal_length - 15);
+  }
+  std::memcpy(op, literals, literal_length);
+  op += literal_length;
+
+  size_t ml = 0;
+  if (offset > 0)
+  {
+    *op++ = static_cast<unsigned char>(offset & 0xff);
+    *op++ = static_cast<unsigned char>(offset >> 8);
+
+    ml = match_length - MIN_MATCH;
+    if (ml >= 15)
+    {
+      op = write_length(op, ml - 15);
+      ml = 15;
+    }
+  }
+
+  *token = static_cast<unsigned char>((ll << 4) | ml);
+  return op;
+}
+
+/// Read the extra bytes of a length field into `length`. Returns false if
+/// the input ends first.
+bool
+read_length(
+  unsigned char const *& ip,
+  unsigned char const * iend,
+  size_t & length) noexcept
+{
+  unsigned char b = 0;
+  do
+  {
+    if (ip == iend)
+    {
+      return false;
+    }
+    b = *ip++;
+    length += b;
+  } while (255 == b);
+
+  return true;
+}
+
+}  // namespace
+
+uint32_t
+null_codec::id() const noexcept
+{
+  return NULL_CODEC_ID;
+}
+
+size_t
+null_codec::max_compressed_size(size_t size) const noexcept
+{
+  return size;
+}
+
+size_t
+null_codec::compress(void const * src, size_t size, void * dst) const noexcept
+{
+  std::memcpy(dst, src, size);
+  return size;
+}
+
+bool
+null_codec::decompress(
+  void const * src,
+  size_t size,
+  void * dst,
+  size_t dst_size) const noexcept
+{
+  if (size != dst_size)
+  {
+    return false;
+  }
+
+  std::memcpy(dst, src, size);
+  return true;
+}
+
+uint32_t
+lz_codec::id() const noexcept
+{
+  return LZ_CODEC_ID;
+}
+
+size_t
+lz_codec::max_compressed_size(size_t size) const noexcept
+{
+  // All literals: the token and the extra length bytes.
+  return size + size / 255 + 16;
+}
+
+size_t
+lz_codec::compress(void const * src, size_t size, void * dst) const noexcept
+{
+  auto const * const base = static_cast<unsigned char const *>(src);
+  auto const * const iend = base + size;
+  auto * op = static_cast<unsigned char *>(dst);
+
+  unsigned char const * ip = base;
+  unsigned char const * anchor = base;  // The first pending literal.
+
+  if (size > MIN_MATCH + LAST_LITERALS)
+  {
+    // The positions of the last 4-byte sequences by their hash. A stale or
+    // colliding entry is caught by comparing the bytes.
+    uint32_t table[1U << HASH_BITS] = {};
+
+    unsigned char const * const match_limit = iend - LAST_LITERALS;
+    unsigned char const * const search_limit = match_limit - MIN_MATCH;
+    size_t misses = 0;
+
+    while (ip < search_limit)
+    {
+      const uint32_t seq = read32(ip);
+      const uint32_t h = hash(seq);
+      unsigned char const * ref = base + table[h];
+      table[h] = static_cast<uint32_t>(ip - base);
+
+      if (ref >= ip || static_cast<size_t>(ip - ref) > MAX_OFFSET ||
+          read32(ref) != seq)
+      {
+        ip += 1 + (misses++ >> SKIP_SHIFT);
+        continue;
+      }
+
+      const size_t length =
+        MIN_MATCH + match_length(ip + MIN_MATCH, ref + MIN_MATCH, match_limit);
+      op = write_sequence(
+        op,
+        anchor,
+        static_cast<size_t>(ip - anchor),
+        static_cast<size_t>(ip - ref),
+        length);
+
+      ip += length;
+      anchor = ip;
+      misses = 0;
+
+      // Remember a position inside the match, which helps the next search
+      // in repetitive data.
+      if (ip < search_limit)
+      {
+        table[hash(read32(ip - 2))] = static_cast<uint32_t>(ip - 2 - base);
+      }
+    }
+  }
+
+  op = write_sequence(op, anchor, static_cast<size_t>(iend - anchor), 0, 0);
+
+  return static_cast<size_t>(op - static_cast<unsigned char *>(dst));
+}
+
+bool
+lz_codec::decompress(
+  void const * src,
+  size_t size,
+  void * dst,
+  size_t dst_size) const noexcept
+{
+  auto const * ip = static_cast<unsigned char const *>(src);
+  auto const * const iend = ip + size;
+  auto * const ostart = static_cast<unsigned char *>(dst);
+  auto * const oend = ostart + dst_size;
+  unsigned char * op = ostart;
+
+  while (ip < iend)
+  {
+    const unsigned char token = *ip++;
+
+    size_t literal_length = token >> 4;
+    if (15 == literal_length && !read_length(ip, iend, literal_length))
+    {
+      return false;
+    }
+    if (literal_length > static_cast<size_t>(iend - ip) ||
+        literal_length > static_cast<size_t>(oend - op))
+    {
+      return false;
+    }
+    if (literal_length <= COPY_SLACK && iend - ip >= COPY_SLACK &&
+        oend - op >= COPY_SLACK)
+    {
+      // Copy a fixed size, which is much faster than a variable size, and
+      // let the next sequence overwrite the extra bytes.
+      std::memcpy(op, ip, COPY_SLACK);
+    }
+    else
+    {
+      std::memcpy(op, ip, literal_length);
+    }
+    ip += literal_length;
+    op += literal_length;
+
+    if (ip == iend)
+    {
+      // The last sequence.
+      break;
+    }
+
+    if (iend - ip < 2)
+    {
+      return false;
+    }
+    const size_t offset = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+    ip += 2;
+
+    size_t length = token & 15;
+    if (15 == length && !read_length(ip, iend, length))
+    {
+      return false;
+    }
+    length += MIN_MATCH;
+
+    if (0 == offset || offset > static_cast<size_t>(op - ostart) ||
+        length > static_cast<size_t>(oend - op))
+    {
+      return false;
+    }
+
+    unsigned char const * ref = op - offset;
+    if (offset >= 8 && static_cast<size_t>(oend - op) >= length + 8)
+    {
+      // Copy 8 bytes at a time, which may write up to 7 bytes past the match
+      // (within the buffer), and never reads the bytes being written.
+      for (size_t i = 0; i < length; i += 8)
+      {
+        std::memcpy(op + i, ref + i, 8);
+      }
+      op += length;
+    }
+    else if (offset >= length)
+    {
+      std::memcpy(op, ref, length);
+      op += length;
+    }
+    else
+    {
+      // The match overlaps the bytes it writes (e.g., a run of a byte).
+      for (size_t i = 0; i < length; ++i)
+      {
+        *op++ = *ref++;
+      }
+    }
+  }
+
+  return op == oend;
+}
+
+}  // namespace ywen
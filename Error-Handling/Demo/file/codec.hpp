@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ywen
+{
+
+/// The interface of a block compression codec, which compresses and
+/// decompresses independent blocks of data. A codec is stateless, so the
+/// same codec can work on many blocks in parallel.
+class codec
+{
+public:
+  virtual ~codec() = default;
+
+  /// Return the ID of the codec, which is stored in the compressed files to
+  /// check that they are read with the same codec.
+  virtual uint32_t
+  id() const noexcept = 0;
+
+  /// Return the size of the buffer that `compress` needs for `size` bytes in
+  /// the worst case.
+  virtual size_t
+  max_compressed_size(size_t size) const noexcept = 0;
+
+  /// Compress the `size` bytes at `src` into `dst`, which has at least
+  /// `max_compressed_size(size)` bytes. Returns the compressed size.
+  virtual size_t
+  compress(void const * src, size_t size, void * dst) const noexcept = 0;
+
+  /// Decompress the `size` bytes at `src` into exactly `dst_size` bytes at
+  /// `dst`. Returns false if `src` is malformed or doesn't decompress to
+  /// `dst_size` bytes, in which case `dst` may have been partially written.
+  /// It never reads or writes out of the bounds of the buffers, even if
+  /// `src` is malformed.
+  virtual bool
+  decompress(void const * src, size_t size, void * dst, size_t dst_size)
+    const noexcept = 0;
+};
+
+/// A codec that stores the data as it is, for comparison and for data that
+/// doesn't compress.
+class null_codec : public codec
+{
+public:
+  uint32_t
+  id() const noexcept override;
+
+  size_t
+  max_compressed_size(size_t size) const noexcept override;
+
+  size_t
+  compress(void const * src, size_t size, void * dst) const noexcept override;
+
+  bool
+  decompress(void const * src, size_t size, void * dst, size_t dst_size)
+    const noexcept override;
+};
+
+/// A fast LZ77 codec in the style of LZ4, which favors speed over ratio.
+///
+/// The compressed data is a sequence of
+///
+///   token | literal length extra bytes | literals
+///         | match offset (2 bytes, little-endian) | match length extra bytes
+///
+/// The high 4 bits of the token are the number of literals and the low 4
+/// bits are the match length minus 4. When a field is 15, the extra bytes
+/// follow, each of which is added to it until one is less than 255. The
+/// match copies the match length bytes starting at match offset bytes
+/// before the output position, which may overlap the bytes being written.
+/// The last sequence has only the token and the literals.
+///
+/// The matches are found greedily with a hash table of the positions of the
+/// last 4-byte sequences, and the search skips ahead faster when no match
+/// is found for a while, so data that doesn't compress is passed quickly.
+class lz_codec : public codec
+{
+public:
+  uint32_t
+  id() const noexcept override;
+
+  size_t
+  max_compressed_size(size_t size) const noexcept override;
+
+  size_t
+  compress(void const * src, size_t size, void * dst) const noexcept override;
+
+  bool
+  decompress(void const * src, size_t size, void * dst, size_t dst_size)
+    const noexcept override;
+};
+
+}  // namespace ywen
@@ -0,0 +1,355 @@
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+
+#include <sys/uio.h>
+
+#include "compressed_file.hpp"
+#include "crc32c.hpp"
+
+namespace ywen
+{
+
+namespace
+{
+
+struct footer
+{
+  char magic[8];
+  uint64_t block_count;
+  uint64_t size;
+  uint32_t block_size;
+  uint32_t codec_id;
+  uint32_t index_crc;
+
+  /// The CRC-32C of the bytes above.
+  uint32_t crc;
+};
+
+static_assert(sizeof(footer) == 40, "");
+static_assert(sizeof(compressed_block_entry) == 24, "");
+
+constexpr char MAGIC[8] = {'Y', 'W', 'C', 'O', 'M', 'P', 'R', '1'};
+
+/// The number of blocks compressed together per thread, and the most
+/// blocks written by one `pwritev`, which is far below `IOV_MAX`.
+constexpr size_t BATCH_PER_THREAD = 2;
+constexpr size_t MAX_BATCH = 64;
+
+uint32_t
+footer_crc(footer const & f) noexcept
+{
+  return crc32c(&f, offsetof(footer, crc));
+}
+
+}  // namespace
+
+compressed_writer::compressed_writer(
+  file & f,
+  codec const & c,
+  size_t block_size,
+  thread_pool * pool)
+  : m_file(f),
+    m_codec(c),
+    m_block_size(block_size),
+    m_pool(pool),
+    m_batch_blocks(std::min(
+      MAX_BATCH,
+      BATCH_PER_THREAD * (nullptr == pool ? 1 : pool->size() + 1))),
+    m_max_compressed_size(
+      std::max(block_size, c.max_compressed_size(block_size))),
+    m_input(new char[m_batch_blocks * block_size]),
+    m_input_size(0),
+    m_output(new char[m_batch_blocks * m_max_compressed_size]),
+    m_offset(0),
+    m_total(0),
+    m_finished(false)
+{
+  assert((block_size > 0));
+  assert((block_size <= std::numeric_limits<uint32_t>::max()));
+}
+
+void
+compressed_writer::write(void const * data, size_t size)
+{
+  assert((!m_finished));
+
+  char const * p = static_cast<char const *>(data);
+  const size_t capacity = m_batch_blocks * m_block_size;
+
+  while (size > 0)
+  {
+    const size_t n = std::min(size, capacity - m_input_size);
+    std::memcpy(m_input.get() + m_input_size, p, n);
+    m_input_size += n;
+    p += n;
+    size -= n;
+
+    if (m_input_size == capacity)
+    {
+      this->_flush();
+    }
+  }
+}
+
+void
+compressed_writer::finish()
+{
+  assert((!m_finished));
+
+  this->_flush();
+
+  const size_t index_size = m_index.size() * sizeof(compressed_block_entry);
+
+  footer ft = {};
+  std::memcpy(ft.magic, MAGIC, sizeof(MAGIC));
+  ft.block_count = m_index.size();
+  ft.size = m_total;
+  ft.block_size = static_cast<uint32_t>(m_block_size);
+  ft.codec_id = m_codec.id();
+  ft.index_crc = crc32c(m_index.data(), index_size);
+  ft.crc = footer_crc(ft);
+
+  struct iovec iov[2] = {
+    {m_index.data(), index_size},
+    {&ft, sizeof(ft)},
+  };
+  m_file.pwrite_vectored(iov, 2, m_offset);
+
+  m_finished = true;
+}
+
+void
+compressed_writer::_flush()
+{
+  if (0 == m_input_size)
+  {
+    return;
+  }
+
+  const size_t count = (m_input_size + m_block_size - 1) / m_block_size;
+  const size_t first = m_index.size();
+  m_index.resize(first + count);
+
+  auto compress = [this, first](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i)
+    {
+      char const * src = m_input.get() + i * m_block_size;
+      const size_t size =
+        std::min(m_block_size, m_input_size - i * m_block_size);
+      char * dst = m_output.get() + i * m_max_compressed_size;
+
+      compressed_block_entry & entry = m_index[first + i];
+      entry.size = static_cast<uint32_t>(size);
+      entry.flags = 0;
+
+      size_t compressed_size = m_codec.compress(src, size, dst);
+      if (compressed_size >= size)
+      {
+        std::memcpy(dst, src, size);
+        compressed_size = size;
+        entry.flags = compressed_block_entry::STORED;
+      }
+
+      entry.compressed_size = static_cast<uint32_t>(compressed_size);
+      entry.crc = crc32c(dst, compressed_size);
+    }
+  };
+
+  if (m_pool != nullptr)
+  {
+    m_pool->parallel_for(0, count, 1, compress);
+  }
+  else
+  {
+    compress(0, count);
+  }
+
+  // The compressed blocks are written back to back, from the slots of
+  // `m_output`.
+  struct iovec iov[MAX_BATCH];
+  for (size_t i = 0; i < count; ++i)
+  {
+    compressed_block_entry & entry = m_index[first + i];
+    entry.offset = static_cast<uint64_t>(m_offset);
+    m_offset += static_cast<off_t>(entry.compressed_size);
+
+    iov[i] = {
+      m_output.get() + i * m_max_compressed_size, entry.compressed_size};
+  }
+  m_file.pwrite_vectored(
+    iov, count, static_cast<off_t>(m_index[first].offset));
+
+  m_total += m_input_size;
+  m_input_size = 0;
+}
+
+compressed_reader::compressed_reader(file const & f, codec const & c)
+  : m_file(f), m_codec(c), m_size(0), m_block_size(0)
+{
+  auto corrupt = [this]() {
+    return file_corrupt_error(
+      m_file.fpath().c_str(), file_corrupt_error::HEADER);
+  };
+
+  const size_t file_size = m_file.size();
+  if (file_size < sizeof(footer))
+  {
+    throw corrupt();
+  }
+
+  footer ft;
+  const off_t footer_offset = static_cast<off_t>(file_size - sizeof(footer));
+  if (m_file.pread(&ft, sizeof(ft), footer_offset) != sizeof(ft) ||
+      std::memcmp(ft.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+      ft.crc != footer_crc(ft) || ft.codec_id != m_codec.id() ||
+      0 == ft.block_size ||
+      ft.block_count >
+        (file_size - sizeof(footer)) / sizeof(compressed_block_entry) ||
+      ft.block_count != (ft.size + ft.block_size - 1) / ft.block_size)
+  {
+    throw corrupt();
+  }
+
+  m_index.resize(static_cast<size_t>(ft.block_count));
+  const size_t index_size = m_index.size() * sizeof(compressed_block_entry);
+  const off_t index_offset = footer_offset - static_cast<off_t>(index_size);
+  if (index_offset < 0 ||
+      m_file.pread(m_index.data(), index_size, index_offset) != index_size ||
+      crc32c(m_index.data(), index_size) != ft.index_crc)
+  {
+    throw corrupt();
+  }
+
+  m_size = ft.size;
+  m_block_size = ft.block_size;
+}
+
+uint64_t
+compressed_reader::size() const noexcept
+{
+  return m_size;
+}
+
+size_t
+compressed_reader::block_size() const noexcept
+{
+  return m_block_size;
+}
+
+size_t
+compressed_reader::block_count() const noexcept
+{
+  return m_index.size();
+}
+
+size_t
+compressed_reader::pread(
+  void * buf,
+  size_t count,
+  uint64_t offset,
+  thread_pool * pool) const
+{
+  if (offset >= m_size)
+  {
+    return 0;
+  }
+  count = static_cast<size_t>(std::min<uint64_t>(count, m_size - offset));
+  if (0 == count)
+  {
+    return 0;
+  }
+
+  const size_t first = static_cast<size_t>(offset / m_block_size);
+  const size_t last = static_cast<size_t>((offset + count - 1) / m_block_size);
+  char * const dst = static_cast<char *>(buf);
+
+  auto read = [this, offset, count, dst](size_t begin, size_t end) {
+    for (size_t b = begin; b < end; ++b)
+    {
+      // The part of block `b` in the range, relative to the block.
+      const uint64_t block_offset = static_cast<uint64_t>(b) * m_block_size;
+      const uint64_t lo = std::max(offset, block_offset);
+      const uint64_t hi =
+        std::min<uint64_t>(offset + count, block_offset + m_block_size);
+
+      this->_read_block(
+        b,
+        static_cast<size_t>(lo - block_offset),
+        static_cast<size_t>(hi - block_offset),
+        dst + (lo - offset));
+    }
+  };
+
+  if (pool != nullptr && last > first)
+  {
+    pool->parallel_for(first, last + 1, 1, read);
+  }
+  else
+  {
+    read(first, last + 1);
+  }
+
+  return count;
+}
+
+void
+compressed_reader::_read_block(
+  size_t b,
+  size_t begin,
+  size_t end,
+  char * dst) const
+{
+  compressed_block_entry const & entry = m_index[b];
+
+  const uint64_t expected_size = std::min<uint64_t>(
+    m_block_size, m_size - static_cast<uint64_t>(b) * m_block_size);
+  if (entry.size != expected_size ||
+      entry.compressed_size > m_codec.max_compressed_size(entry.size) ||
+      (entry.flags == compressed_block_entry::STORED &&
+       entry.compressed_size != entry.size))
+  {
+    throw file_corrupt_error(m_file.fpath().c_str(), b);
+  }
+
+  std::unique_ptr<char[]> stored(new char[entry.compressed_size]);
+  if (m_file.pread(
+        stored.get(),
+        entry.compressed_size,
+        static_cast<off_t>(entry.offset)) != entry.compressed_size ||
+      crc32c(stored.get(), entry.compressed_size) != entry.crc)
+  {
+    throw file_corrupt_error(m_file.fpath().c_str(), b);
+  }
+
+  if (entry.flags == compressed_block_entry::STORED)
+  {
+    std::memcpy(dst, stored.get() + begin, end - begin);
+    return;
+  }
+
+  // Decompress the whole block directly into `dst` if it's wanted
+  // completely, and into a temporary buffer otherwise.
+  std::unique_ptr<char[]> block;
+  char * out = dst;
+  if (begin > 0 || end < entry.size)
+  {
+    block.reset(new char[entry.size]);
+    out = block.get();
+  }
+
+  if (!m_codec.decompress(
+        stored.get(), entry.compressed_size, out, entry.size))
+  {
+    throw file_corrupt_error(m_file.fpath().c_str(), b);
+  }
+
+  if (out != dst)
+  {
+    std::memcpy(dst, out + begin, end - begin);
+  }
+}
+
+}  // namespace ywen
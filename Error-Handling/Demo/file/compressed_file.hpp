@@ -0,0 +1,186 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <sys/types.h>
+
+#include "../thread_pool/thread_pool.hpp"
+#include "codec.hpp"
+#include "exception.hpp"
+#include "file.hpp"
+
+namespace ywen
+{
+
+// NOTE(ywen): The compressed file format:
+//
+//   block 0 .. block N-1   (compressed, back to back)
+//   index                  (an entry per block)
+//   footer                 (40 bytes)
+//
+// The data is cut into blocks of `block_size` bytes (the last one may be
+// shorter), and every block is compressed on its own, so the blocks can be
+// compressed and decompressed in parallel, and any byte range can be read
+// by decompressing only the blocks it overlaps. A block that doesn't get
+// smaller is stored as it is.
+//
+// An index entry holds the offset, the compressed size, the uncompressed
+// size and the CRC-32C of the stored bytes of a block. The footer holds the
+// number of blocks, the total uncompressed size, the block size, the ID of
+// the codec, the CRC-32C of the index and its own CRC-32C. The index and
+// the footer are written last, so a file whose writing does not finish
+// can't be read.
+
+/// The default uncompressed size of a block.
+constexpr size_t DEFAULT_COMPRESSED_BLOCK_SIZE = 256U << 10;
+
+/// An entry of the index of a compressed file.
+struct compressed_block_entry
+{
+  /// The offset of the stored bytes in the file.
+  uint64_t offset;
+  uint32_t compressed_size;
+  uint32_t size;
+
+  /// The CRC-32C of the stored bytes.
+  uint32_t crc;
+
+  /// `STORED` if the block is stored as it is.
+  uint32_t flags;
+
+  static constexpr uint32_t STORED = 1;
+};
+
+/// Write data to a file in the compressed file format, in as many pieces as
+/// needed. The data is staged until there are enough blocks for all the
+/// threads, and then they are compressed in parallel and written with one
+/// `pwritev`.
+class compressed_writer
+{
+public:
+  /// Start writing to `f`, which must be open for writing, from the
+  /// beginning of the file. `block_size` must be at least 1 and less than 4
+  /// GiB. `c` and `pool` (which may be `nullptr` to compress on the calling
+  /// thread) must outlive the writer.
+  ///
+  /// Throws:
+  /// - `std::bad_alloc`: When out of memory.
+  compressed_writer(
+    file & f,
+    codec const & c,
+    size_t block_size = DEFAULT_COMPRESSED_BLOCK_SIZE,
+    thread_pool * pool = nullptr);
+
+  compressed_writer(compressed_writer const &) = delete;
+
+  compressed_writer &
+  operator=(compressed_writer const &) = delete;
+
+  /// Append the `size` bytes at `data`.
+  ///
+  /// Throws:
+  /// - `std::bad_alloc`: When out of memory.
+  /// - file_write_error:
+  void
+  write(void const * data, size_t size);
+
+  /// Write the staged blocks, the index and the footer. No data can be
+  /// written after it.
+  ///
+  /// Throws:
+  /// - `std::bad_alloc`: When out of memory.
+  /// - file_write_error:
+  void
+  finish();
+
+private:
+  /// Compress and write the staged blocks.
+  void
+  _flush();
+
+private:
+  file & m_file;
+  codec const & m_codec;
+  const size_t m_block_size;
+  thread_pool * const m_pool;
+
+  /// The number of blocks that are compressed together.
+  const size_t m_batch_blocks;
+  const size_t m_max_compressed_size;
+
+  /// The staged data and the buffer of their compressed blocks.
+  std::unique_ptr<char[]> m_input;
+  size_t m_input_size;
+  std::unique_ptr<char[]> m_output;
+
+  std::vector<compressed_block_entry> m_index;
+  off_t m_offset;
+  uint64_t m_total;
+  bool m_finished;
+};
+
+/// Read data from a file in the compressed file format, at any offset.
+class compressed_reader
+{
+public:
+  /// Read and check the footer and the index of `f`, which must be open for
+  /// reading. `f` and `c` must outlive the reader.
+  ///
+  /// Throws:
+  /// - `std::bad_alloc`: When out of memory.
+  /// - file_read_error:
+  /// - file_corrupt_error: `block()` is `file_corrupt_error::HEADER` when
+  ///   the footer or the index is corrupt, or the file is written with
+  ///   another codec.
+  compressed_reader(file const & f, codec const & c);
+
+  compressed_reader(compressed_reader const &) = delete;
+
+  compressed_reader &
+  operator=(compressed_reader const &) = delete;
+
+  /// Return the total uncompressed size.
+  uint64_t
+  size() const noexcept;
+
+  size_t
+  block_size() const noexcept;
+
+  size_t
+  block_count() const noexcept;
+
+  /// Read up to `count` bytes at `offset` of the uncompressed data into
+  /// `buf`, decompressing the blocks that overlap the range on `pool` if
+  /// it's not `nullptr`. The blocks that are completely in the range are
+  /// decompressed directly into `buf`. Returns the number of bytes read,
+  /// which is less than `count` only at the end. It can be called by
+  /// multiple threads concurrently.
+  ///
+  /// Throws:
+  /// - `std::bad_alloc`: When out of memory.
+  /// - file_read_error:
+  /// - file_corrupt_error: `block()` is a corrupt block in the range.
+  size_t
+  pread(
+    void * buf,
+    size_t count,
+    uint64_t offset,
+    thread_pool * pool = nullptr) const;
+
+private:
+  /// Decompress the part `[begin, end)` of block `b` into `dst`.
+  void
+  _read_block(size_t b, size_t begin, size_t end, char * dst) const;
+
+private:
+  file const & m_file;
+  codec const & m_codec;
+  uint64_t m_size;
+  size_t m_block_size;
+  std::vector<compressed_block_entry> m_index;
+};
+
+}  // namespace ywen
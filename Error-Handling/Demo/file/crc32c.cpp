@@ -0,0 +1,95 @@
+#include <array>
+#include <cstring>
+
+#include "crc32c.hpp"
+
+namespace ywen
+{
+
+namespace
+{
+
+/// The reflected polynomial of CRC-32C.
+constexpr uint32_t POLY = 0x82f63b78;
+
+constexpr std::array<uint32_t, 256>
+make_table() noexcept
+{
+  std::array<uint32_t, 256> table = {};
+  for (uint32_t i = 0; i < 256; ++i)
+  {
+    uint32_t c = i;
+    for (int k = 0; k < 8; ++k)
+    {
+      c = (c & 1 ? (c >> 1) ^ POLY : c >> 1);
+    }
+    table[i] = c;
+  }
+  return table;
+}
+
+constexpr std::array<uint32_t, 256> TABLE = make_table();
+
+/// The portable version, one byte at a time. `crc` is not inverted.
+uint32_t
+crc32c_table(unsigned char const * p, size_t size, uint32_t crc) noexcept
+{
+  for (size_t i = 0; i < size; ++i)
+  {
+    crc = TABLE[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+  }
+  return crc;
+}
+
+#if defined(__x86_64__)
+
+/// The SSE4.2 version, 8 bytes at a time. `crc` is not inverted.
+__attribute__((target("sse4.2"))) uint32_t
+crc32c_sse42(unsigned char const * p, size_t size, uint32_t crc) noexcept
+{
+  uint64_t c = crc;
+
+  for (; size >= 8; p += 8, size -= 8)
+  {
+    uint64_t word;
+    std::memcpy(&word, p, 8);  // `p` may not be aligned.
+    c = __builtin_ia32_crc32di(c, word);
+  }
+
+  uint32_t c32 = static_cast<uint32_t>(c);
+  for (; size > 0; ++p, --size)
+  {
+    c32 = __builtin_ia32_crc32qi(c32, *p);
+  }
+
+  return c32;
+}
+
+/// `__builtin_cpu_init` must be called before `__builtin_cpu_supports` when
+/// it may run before the other static constructors. Until this is
+/// initialized, the table is used.
+const bool HAS_SSE42 = []() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("sse4.2") != 0;
+}();
+
+#endif
+
+}  // namespace
+
+uint32_t
+crc32c(void const * data, size_t size, uint32_t crc) noexcept
+{
+  auto const * p = static_cast<unsigned char const *>(data);
+
+#if defined(__x86_64__)
+  if (HAS_SSE42)
+  {
+    return ~crc32c_sse42(p, size, ~crc);
+  }
+#endif
+
+  return ~crc32c_table(p, size, ~crc);
+}
+
+}  // namespace ywen
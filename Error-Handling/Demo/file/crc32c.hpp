@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ywen
+{
+
+/// Return the CRC-32C (Castagnoli) of the `size` bytes at `data`, continuing
+/// from `crc`, which is the CRC of the preceding bytes (0 for none). So
+/// `crc32c(b, nb, crc32c(a, na))` is the CRC of `a` followed by `b`.
+///
+/// The SSE4.2 `crc32` instruction is used when the CPU supports it, and a
+/// lookup table otherwise.
+uint32_t
+crc32c(void const * data, size_t size, uint32_t crc = 0) noexcept;
+
+}  // namespace ywen
@@ -1,50 +1,155 @@
 #pragma once
 
-#include <stdexcept>
-#include <string>
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <exception>
 
 namespace ywen
 {
 
-class file_error_base : public std::runtime_error
+/// The base class of the file exceptions.
+///
+/// Throwing a file exception does not allocate any memory (other than the
+/// exception object itself, which the C++ runtime allocates): the path is
+/// copied into a fixed-size buffer inside the object, and the message
+/// returned by `what()` is only formatted when `what()` is called, into a
+/// per-thread buffer. So the exceptions can be thrown under memory pressure,
+/// and copying them never throws.
+class file_error_base : public std::exception
 {
 public:
-  /// Throws:
-  /// - std::bad_alloc
-  file_error_base(std::string const & fpath, int err_no) noexcept
-    : std::runtime_error(""), m_fpath(fpath), m_err_no(err_no)
+  /// The size of the buffer that holds a path, including the terminating
+  /// null character. A longer path is truncated to its last
+  /// `PATH_CAPACITY - 4` characters, preceded by "...".
+  static constexpr size_t PATH_CAPACITY = 256;
+
+  file_error_base(char const * fpath, int err_no) noexcept
+    : file_error_base("file error", fpath, err_no)
   {
     // Empty
   }
 
-  // TODO(ywen): What about copy/move constructor/assignment/?
-  // TODO(ywen): What about destructor?
+  // The destructor, copy constructor and copy assignment operator are the
+  // implicit ones, which do not throw because all the members are plain
+  // values.
 
-  std::string
+  /// Return the path of the file, which may be truncated (see
+  /// `fpath_truncated`).
+  char const *
   fpath() const noexcept
   {
-    // TODO(ywen): Does std::string copy assignment throw?
     return m_fpath;
   }
 
+  /// Check if the path is too long to fit in the buffer and was truncated.
+  bool
+  fpath_truncated() const noexcept
+  {
+    return m_fpath_truncated;
+  }
+
   int
   err_no() const noexcept
   {
     return m_err_no;
   }
 
+  /// Return a message like "failed to open '/tmp/a.txt': No such file or
+  /// directory (errno 2)".
+  ///
+  /// The message is formatted into a per-thread buffer, so it is valid until
+  /// the next call of `what()` of any file exception on the same thread.
+  char const *
+  what() const noexcept override
+  {
+    char * buf = _what_buffer();
+    char errbuf[128];
+
+    std::snprintf(
+      buf,
+      WHAT_CAPACITY,
+      "%s '%s': %s (errno %d)",
+      m_what,
+      m_fpath,
+      _strerror(::strerror_r(m_err_no, errbuf, sizeof(errbuf)), errbuf),
+      m_err_no);
+
+    return buf;
+  }
+
+protected:
+  /// `what` must be a string literal that describes the operation, such as
+  /// "failed to open".
+  file_error_base(char const * what, char const * fpath, int err_no) noexcept
+    : m_what(what), m_err_no(err_no)
+  {
+    m_fpath_truncated = _copy_path(m_fpath, fpath);
+  }
+
+  /// The size of the per-thread buffer of `what()`, which is big enough for
+  /// two paths.
+  static constexpr size_t WHAT_CAPACITY = PATH_CAPACITY * 2 + 256;
+
+  /// Return the per-thread buffer of `what()`.
+  static char *
+  _what_buffer() noexcept
+  {
+    thread_local char buf[WHAT_CAPACITY];
+    return buf;
+  }
+
+  /// Return the message of the XSI-compliant `strerror_r`.
+  static char const *
+  _strerror(int ret, char const * buf) noexcept
+  {
+    return (0 == ret ? buf : "Unknown error");
+  }
+
+  /// Return the message of the GNU-specific `strerror_r`.
+  static char const *
+  _strerror(char const * ret, char const *) noexcept
+  {
+    return ret;
+  }
+
+  /// Copy `src` (`nullptr` means an empty path) to `dst`, truncating it if
+  /// it is too long. Returns whether it is truncated.
+  static bool
+  _copy_path(char (&dst)[PATH_CAPACITY], char const * src) noexcept
+  {
+    const size_t len = (nullptr == src ? 0 : std::strlen(src));
+    if (0 == len)
+    {
+      dst[0] = '\0';
+      return false;
+    }
+
+    if (len < PATH_CAPACITY)
+    {
+      std::memcpy(dst, src, len + 1);
+      return false;
+    }
+
+    // Keep the end of the path, which is usually more informative.
+    std::memcpy(dst, "...", 3);
+    std::memcpy(dst + 3, src + len - (PATH_CAPACITY - 4), PATH_CAPACITY - 3);
+    return true;
+  }
+
 private:
-  std::string m_fpath;
+  char const * m_what;
+  char m_fpath[PATH_CAPACITY];
+  bool m_fpath_truncated;
   int m_err_no;
 };
 
 class file_open_error : public file_error_base
 {
 public:
-  /// Throws:
-  /// - std::bad_alloc:
-  file_open_error(std::string const & fpath, int err_no) noexcept
-    : file_error_base(fpath, err_no)
+  file_open_error(char const * fpath, int err_no) noexcept
+    : file_error_base("failed to open", fpath, err_no)
   {
     // Empty
   }
@@ -53,13 +158,9 @@ public:
 class file_close_error : public file_error_base
 {
 public:
-  /// Throws:
-  /// - std::bad_alloc:
-  file_close_error(
-    std::string const & fpath,
-    int fclose_ret,
-    int err_no) noexcept
-    : file_error_base(fpath, err_no), m_fclose_ret(fclose_ret)
+  file_close_error(char const * fpath, int fclose_ret, int err_no) noexcept
+    : file_error_base("failed to close", fpath, err_no)
+    , m_fclose_ret(fclose_ret)
   {
     // Empty
   }
@@ -74,4 +175,226 @@ private:
   int m_fclose_ret;
 };
 
+class file_read_error : public file_error_base
+{
+public:
+  file_read_error(char const * fpath, int err_no) noexcept
+    : file_error_base("failed to read", fpath, err_no)
+  {
+    // Empty
+  }
+};
+
+class file_write_error : public file_error_base
+{
+public:
+  file_write_error(char const * fpath, int err_no) noexcept
+    : file_error_base("failed to write", fpath, err_no)
+  {
+    // Empty
+  }
+};
+
+class file_copy_error : public file_error_base
+{
+public:
+  /// `fpath` is the source file and `dst_fpath` is the destination file.
+  /// The kernel does not tell which of the two files caused the error.
+  file_copy_error(
+    char const * fpath,
+    char const * dst_fpath,
+    int err_no) noexcept
+    : file_error_base("failed to copy", fpath, err_no)
+  {
+    m_dst_fpath_truncated = _copy_path(m_dst_fpath, dst_fpath);
+  }
+
+  /// Return the path of the destination file, which may be truncated (see
+  /// `dst_fpath_truncated`).
+  char const *
+  dst_fpath() const noexcept
+  {
+    return m_dst_fpath;
+  }
+
+  bool
+  dst_fpath_truncated() const noexcept
+  {
+    return m_dst_fpath_truncated;
+  }
+
+  /// Return a message like "failed to copy '/tmp/a' to '/mnt/b': No space
+  /// left on device (errno 28)". See `file_error_base::what()`.
+  char const *
+  what() const noexcept override
+  {
+    char * buf = _what_buffer();
+    char errbuf[128];
+
+    std::snprintf(
+      buf,
+      WHAT_CAPACITY,
+      "failed to copy '%s' to '%s': %s (errno %d)",
+      this->fpath(),
+      m_dst_fpath,
+      _strerror(::strerror_r(this->err_no(), errbuf, sizeof(errbuf)), errbuf),
+      this->err_no());
+
+    return buf;
+  }
+
+private:
+  char m_dst_fpath[PATH_CAPACITY];
+  bool m_dst_fpath_truncated;
+};
+
+/// The data read from a file fails its integrity check (e.g., a checksum
+/// mismatch). `err_no()` is always `EBADMSG`.
+class file_corrupt_error : public file_error_base
+{
+public:
+  /// The value of `block()` when the header is corrupt.
+  static constexpr size_t HEADER = static_cast<size_t>(-1);
+
+  file_corrupt_error(char const * fpath, size_t block) noexcept
+    : file_error_base("corrupt data in", fpath, EBADMSG), m_block(block)
+  {
+    // Empty
+  }
+
+  /// Return the index of the first corrupt block, or `HEADER`.
+  size_t
+  block() const noexcept
+  {
+    return m_block;
+  }
+
+  /// Return a message like "corrupt block 3 of '/tmp/a': Bad message (errno
+  /// 74)". See `file_error_base::what()`.
+  char const *
+  what() const noexcept override
+  {
+    char * buf = _what_buffer();
+    char errbuf[128];
+    char where[64];
+
+    if (HEADER == m_block)
+    {
+      std::snprintf(where, sizeof(where), "corrupt header");
+    }
+    else
+    {
+      std::snprintf(where, sizeof(where), "corrupt block %zu", m_block);
+    }
+
+    std::snprintf(
+      buf,
+      WHAT_CAPACITY,
+      "%s of '%s': %s (errno %d)",
+      where,
+      this->fpath(),
+      _strerror(::strerror_r(this->err_no(), errbuf, sizeof(errbuf)), errbuf),
+      this->err_no());
+
+    return buf;
+  }
+
+private:
+  size_t m_block;
+};
+
+/// The operations on a file that may fail.
+enum class file_op : int
+{
+  open,
+  close,
+  read,
+  write,
+  copy,
+};
+
+/// The value counterpart of the exception classes above, which is returned
+/// by the non-throwing `file::try_*` functions.
+///
+/// Unlike the exceptions, it doesn't copy the paths: `fpath` and `dst_fpath`
+/// point to the paths owned by the `file` objects, so a `file_error` must
+/// not be used after the `file` objects it comes from are destroyed. This
+/// makes a `file_error` free to create, which matters when the error is the
+/// common case (e.g., "file not found" when probing directories).
+class file_error
+{
+public:
+  constexpr file_error(
+    file_op op,
+    char const * fpath,
+    int err_no,
+    char const * dst_fpath = nullptr) noexcept
+    : m_op(op), m_fpath(fpath), m_err_no(err_no), m_dst_fpath(dst_fpath)
+  {
+    // Empty
+  }
+
+  file_op
+  op() const noexcept
+  {
+    return m_op;
+  }
+
+  char const *
+  fpath() const noexcept
+  {
+    return m_fpath;
+  }
+
+  int
+  err_no() const noexcept
+  {
+    return m_err_no;
+  }
+
+  /// The destination file of `file_op::copy`; `nullptr` otherwise.
+  char const *
+  dst_fpath() const noexcept
+  {
+    return m_dst_fpath;
+  }
+
+  /// Throw the exception that corresponds to `op()`.
+  ///
+  /// Throws:
+  /// - file_open_error: `file_op::open`.
+  /// - file_close_error: `file_op::close`.
+  /// - file_read_error: `file_op::read`.
+  /// - file_write_error: `file_op::write`.
+  /// - file_copy_error: `file_op::copy`.
+  [[noreturn]] void
+  raise() const
+  {
+    switch (m_op)
+    {
+    case file_op::open:
+      throw file_open_error(m_fpath, m_err_no);
+
+    case file_op::close:
+      throw file_close_error(m_fpath, EOF, m_err_no);
+
+    case file_op::read:
+      throw file_read_error(m_fpath, m_err_no);
+
+    case file_op::write:
+      throw file_write_error(m_fpath, m_err_no);
+
+    case file_op::copy:
+    default:
+      throw file_copy_error(m_fpath, m_dst_fpath, m_err_no);
+    }
+  }
+
+private:
+  file_op m_op;
+  char const * m_fpath;
+  int m_err_no;
+  char const * m_dst_fpath;
+};
+
 }  // namespace ywen
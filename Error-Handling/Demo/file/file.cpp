@@ -1,4 +1,17 @@
+#include <algorithm>
+#include <cassert>
 #include <cerrno>
+#include <climits>
+#include <memory>
+#include <new>
+#include <utility>
+
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "exception.hpp"
 #include "file.hpp"
@@ -6,14 +19,267 @@
 namespace ywen
 {
 
-file::file() : m_file(nullptr)
+namespace
+{
+
+/// Transfer all the bytes described by the `count` buffers in `bufs`, until
+/// they are all transferred or the end of the file is reached.
+///
+/// `vectored(iov, iovcnt, done)` is called to transfer whole buffers and
+/// `single(ptr, len, done)` is called to transfer the rest of a buffer that
+/// was transferred partially, so `bufs` never needs to be copied and
+/// adjusted. `done` is the number of bytes that have been transferred so
+/// far, which the positional functions add to their starting offset. Both
+/// callables must behave like `readv`/`read`.
+///
+/// Returns the total number of bytes transferred, or -1 with `errno` set.
+template<typename _Single, typename _Vectored>
+ssize_t
+transfer_all(
+  struct iovec const * bufs,
+  size_t count,
+  _Single single,
+  _Vectored vectored)
+{
+  size_t total = 0;
+  size_t i = 0;     // The first buffer that is not completely transferred.
+  size_t part = 0;  // The number of bytes of `bufs[i]` already transferred.
+
+  while (i < count)
+  {
+    if (part == bufs[i].iov_len)
+    {
+      ++i;
+      part = 0;
+      continue;
+    }
+
+    ssize_t ret = 0;
+    if (part > 0)
+    {
+      ret = single(
+        static_cast<char *>(bufs[i].iov_base) + part,
+        bufs[i].iov_len - part,
+        total);
+    }
+    else
+    {
+      const size_t iovcnt = std::min<size_t>(count - i, IOV_MAX);
+      ret = vectored(bufs + i, static_cast<int>(iovcnt), total);
+    }
+
+    if (ret < 0)
+    {
+      if (EINTR == errno)
+      {
+        continue;
+      }
+      return -1;
+    }
+
+    if (0 == ret)
+    {
+      break;  // The end of the file.
+    }
+
+    total += static_cast<size_t>(ret);
+
+    // Skip the buffers that have been transferred completely.
+    size_t n = static_cast<size_t>(ret);
+    while (n > 0)
+    {
+      const size_t left = bufs[i].iov_len - part;
+      if (n < left)
+      {
+        part += n;
+        n = 0;
+      }
+      else
+      {
+        n -= left;
+        ++i;
+        part = 0;
+      }
+    }
+  }
+
+  return static_cast<ssize_t>(total);
+}
+
+size_t
+total_size(struct iovec const * bufs, size_t count) noexcept
+{
+  size_t total = 0;
+  for (size_t i = 0; i < count; ++i)
+  {
+    total += bufs[i].iov_len;
+  }
+  return total;
+}
+
+/// The most bytes asked from the kernel in one copy system call.
+constexpr size_t COPY_CHUNK_SIZE = 1U << 30;
+
+/// The size of the user space buffer used by `copy_method::buffered`.
+constexpr size_t COPY_BUFFER_SIZE = 1U << 20;
+
+/// Check if `err_no`, set by a copy system call, means the method is not
+/// supported for the two files (so the next method should be tried), rather
+/// than a real I/O error.
+bool
+is_copy_unsupported(int err_no) noexcept
+{
+  return (
+    ENOSYS == err_no || EXDEV == err_no || EINVAL == err_no ||
+    EOPNOTSUPP == err_no);
+}
+
+/// Check if `err_no`, set by `fallocate`, means the file system can't do
+/// the requested operation, rather than a real error.
+bool
+is_fallocate_unsupported(int err_no) noexcept
+{
+  return (EOPNOTSUPP == err_no || ENOSYS == err_no);
+}
+
+/// The zeros written by `file::write_zeroes` when it can't punch a hole.
+constexpr size_t ZERO_BUFFER_SIZE = 64U << 10;
+const char ZERO_BUFFER[ZERO_BUFFER_SIZE] = {};
+
+/// Clone `[offset, offset + length)` of `in` to the current position of
+/// `out` and move the position of `out` past the cloned range.
+///
+/// Returns the number of bytes cloned, 0 if the range can't be cloned (so
+/// the caller should copy it instead), or -1 with `errno` set.
+ssize_t
+clone_range(int in, int out, off_t offset, size_t length)
+{
+#ifdef FICLONERANGE
+  struct stat st;
+  if (::fstat(in, &st) < 0)
+  {
+    return -1;
+  }
+
+  if (offset >= st.st_size || 0 == length)
+  {
+    return 0;
+  }
+
+  const off_t dst_offset = ::lseek(out, 0, SEEK_CUR);
+  if (dst_offset < 0)
+  {
+    return 0;  // E.g., `out` is a pipe.
+  }
+
+  length = std::min(length, static_cast<size_t>(st.st_size - offset));
+
+  // Both offsets must be block-aligned, and so must the length unless the
+  // range ends at the end of the source file.
+  const off_t block = st.st_blksize;
+  const bool to_eof = (offset + static_cast<off_t>(length) == st.st_size);
+  if (
+    0 != offset % block || 0 != dst_offset % block ||
+    (!to_eof && 0 != static_cast<off_t>(length) % block))
+  {
+    return 0;
+  }
+
+  struct file_clone_range range = {};
+  range.src_fd = in;
+  range.src_offset = static_cast<__u64>(offset);
+  range.src_length = static_cast<__u64>(length);
+  range.dest_offset = static_cast<__u64>(dst_offset);
+
+  // Any failure here only means the blocks can't be shared (e.g., the two
+  // files are on different file systems, or the file system can't do it).
+  // Real I/O errors will be reported by the method we fall back to.
+  if (::ioctl(out, FICLONERANGE, &range) < 0)
+  {
+    return 0;
+  }
+
+  if (::lseek(out, dst_offset + static_cast<off_t>(length), SEEK_SET) < 0)
+  {
+    return -1;
+  }
+
+  return static_cast<ssize_t>(length);
+#else
+  return 0;
+#endif
+}
+
+/// Read up to `count` bytes at `offset` of `in` into `buf` and write them to
+/// the current position of `out`.
+///
+/// Returns the number of bytes copied, 0 at the end of the file, or -1 with
+/// `errno` set.
+ssize_t
+copy_buffered(int in, int out, off_t offset, char * buf, size_t count)
+{
+  const ssize_t n = ::pread(in, buf, count, offset);
+  if (n <= 0)
+  {
+    return n;
+  }
+
+  struct iovec iov = {buf, static_cast<size_t>(n)};
+  ssize_t ret = transfer_all(
+    &iov,
+    1,
+    [out](void * p, size_t len, size_t) { return ::write(out, p, len); },
+    [out](struct iovec const * v, int cnt, size_t) {
+      return ::writev(out, v, cnt);
+    });
+  if (ret < 0)
+  {
+    return -1;
+  }
+
+  if (ret != n)
+  {
+    errno = EIO;  // See `file::write_vectored`.
+    return -1;
+  }
+
+  return n;
+}
+
+/// Return the value held by `r`, or throw the exception of its error.
+template<typename _Ty>
+_Ty
+value_or_raise(result<_Ty, file_error> && r)
+{
+  if (!r)
+  {
+    r.error().raise();
+  }
+
+  return std::move(r).value();
+}
+
+/// Throw the exception of the error held by `r`, if any.
+void
+value_or_raise(result<void, file_error> && r)
+{
+  if (!r)
+  {
+    r.error().raise();
+  }
+}
+
+}  // namespace
+
+file::file() : m_file(nullptr), m_preallocated(false)
 {
   // Empty
 }
 
 file::file(std::string const & fpath)
+  : m_fpath(fpath), m_file(nullptr), m_preallocated(false)
 {
-  // TODO(ywen): Implement me!
+  // Empty
 }
 
 file::~file()
@@ -26,6 +292,108 @@ file::~file()
 
 void
 file::open_read()
+{
+  value_or_raise(this->try_open_read());
+}
+
+void
+file::open_write(size_t expected_size)
+{
+  value_or_raise(this->try_open_write(expected_size));
+}
+
+void
+file::open_append()
+{
+}
+
+void
+file::close()
+{
+  value_or_raise(this->try_close());
+}
+
+bool
+file::is_open() const noexcept
+{
+  return (nullptr != m_file);
+}
+
+std::string const &
+file::fpath() const noexcept
+{
+  return m_fpath;
+}
+
+size_t
+file::read(void * buf, size_t count)
+{
+  return value_or_raise(this->try_read(buf, count));
+}
+
+void
+file::write(void const * buf, size_t count)
+{
+  value_or_raise(this->try_write(buf, count));
+}
+
+void
+file::write_zeroes(size_t count)
+{
+  value_or_raise(this->try_write_zeroes(count));
+}
+
+size_t
+file::read_vectored(struct iovec const * bufs, size_t count)
+{
+  return value_or_raise(this->try_read_vectored(bufs, count));
+}
+
+void
+file::write_vectored(struct iovec const * bufs, size_t count)
+{
+  value_or_raise(this->try_write_vectored(bufs, count));
+}
+
+size_t
+file::pread(void * buf, size_t count, off_t offset) const
+{
+  return value_or_raise(this->try_pread(buf, count, offset));
+}
+
+void
+file::pwrite(void const * buf, size_t count, off_t offset)
+{
+  value_or_raise(this->try_pwrite(buf, count, offset));
+}
+
+size_t
+file::pread_vectored(struct iovec const * bufs, size_t count, off_t offset)
+  const
+{
+  return value_or_raise(this->try_pread_vectored(bufs, count, offset));
+}
+
+void
+file::pwrite_vectored(struct iovec const * bufs, size_t count, off_t offset)
+{
+  value_or_raise(this->try_pwrite_vectored(bufs, count, offset));
+}
+
+size_t
+file::size() const
+{
+  return value_or_raise(this->try_size());
+}
+
+size_t
+file::copy_to(file & dst, off_t offset, size_t length, copy_method method)
+{
+  return value_or_raise(this->try_copy_to(dst, offset, length, method));
+}
+
+result<void, file_error>
+file::try_open_read() noexcept
 {
   // Eventually, POSIX `open` is called. Its page details the possible errors:
   // https://pubs.opengroup.org/onlinepubs/9699919799/functions/open.html
@@ -37,23 +405,73 @@ file::open_read()
   std::FILE * fp = std::fopen(m_fpath.data(), "r");
   if (nullptr == fp)
   {
-    throw file_open_error(m_fpath, errno);
+    return file_error(file_op::open, m_fpath.c_str(), errno);
   }
-}
 
-void
-file::open_write()
-{
+  m_file = fp;
+
+  return {};
 }
 
-void
-file::open_append()
+result<void, file_error>
+file::try_open_write(size_t expected_size) noexcept
 {
+  // The file is created if it does not exist, and truncated to zero length
+  // if it does.
+  std::FILE * fp = std::fopen(m_fpath.data(), "w");
+  if (nullptr == fp)
+  {
+    return file_error(file_op::open, m_fpath.c_str(), errno);
+  }
+
+  bool preallocated = false;
+  if (expected_size > 0)
+  {
+    // `posix_fallocate` is not used: it changes the size of the file, and
+    // where the file system can't allocate blocks up front, glibc emulates
+    // it by writing to every block.
+    if (
+      ::fallocate(
+        ::fileno(fp),
+        FALLOC_FL_KEEP_SIZE,
+        0,
+        static_cast<off_t>(expected_size)) == 0)
+    {
+      preallocated = true;
+    }
+    else if (!is_fallocate_unsupported(errno))
+    {
+      const int err_no = errno;
+      std::fclose(fp);
+      return file_error(file_op::open, m_fpath.c_str(), err_no);
+    }
+  }
+
+  m_file = fp;
+  m_preallocated = preallocated;
+
+  return {};
 }
 
-void
-file::close()
+result<void, file_error>
+file::try_close() noexcept
 {
+  // Give back the blocks allocated beyond the end of the file. If it fails,
+  // the file is still closed (see below) and the error is returned.
+  int err_no = 0;
+  if (m_preallocated)
+  {
+    m_preallocated = false;
+
+    struct stat st;
+    if (
+      ::fstat(this->_fd(), &st) != 0 ||
+      ::ftruncate(this->_fd(), st.st_size) != 0)
+    {
+      err_no = errno;
+    }
+  }
+
   int ret = std::fclose(m_file);
 
   // Per [1], "Whether or not the operation succeeds, the stream is no longer
@@ -64,15 +482,318 @@ file::close()
 
   if (EOF == ret)
   {
-    // If the closure failed, we throw an exception to indicate the error.
-    throw file_close_error(m_fpath, ret, errno);
+    // If the closure failed, we return the error.
+    return file_error(file_op::close, m_fpath.c_str(), errno);
   }
+
+  if (err_no != 0)
+  {
+    return file_error(file_op::close, m_fpath.c_str(), err_no);
+  }
+
+  return {};
 }
 
-bool
-file::is_open() const noexcept
+result<size_t, file_error>
+file::try_size() const noexcept
 {
-  return (nullptr != m_file);
+  struct stat st;
+  if (::fstat(this->_fd(), &st) != 0)
+  {
+    return file_error(file_op::read, m_fpath.c_str(), errno);
+  }
+
+  return static_cast<size_t>(st.st_size);
+}
+
+result<size_t, file_error>
+file::try_read(void * buf, size_t count) noexcept
+{
+  struct iovec iov = {buf, count};
+  return this->try_read_vectored(&iov, 1);
+}
+
+result<void, file_error>
+file::try_write(void const * buf, size_t count) noexcept
+{
+  struct iovec iov = {const_cast<void *>(buf), count};
+  return this->try_write_vectored(&iov, 1);
+}
+
+result<void, file_error>
+file::try_write_zeroes(size_t count) noexcept
+{
+  if (0 == count)
+  {
+    return {};
+  }
+
+  const int fd = this->_fd();
+  const off_t offset = ::lseek(fd, 0, SEEK_CUR);
+  struct stat st;
+  if (offset < 0 || ::fstat(fd, &st) != 0)
+  {
+    return file_error(file_op::write, m_fpath.c_str(), errno);
+  }
+
+  const off_t end = offset + static_cast<off_t>(count);
+
+  // Extend the file first: punching a hole doesn't change the size of the
+  // file, and it does nothing beyond the end of the file on some file
+  // systems (e.g., ext4), where the preallocated blocks would stay. The
+  // extended range reads as zeros.
+  if (end > st.st_size && ::ftruncate(fd, end) != 0)
+  {
+    return file_error(file_op::write, m_fpath.c_str(), errno);
+  }
+
+  if (
+    ::fallocate(
+      fd,
+      FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+      offset,
+      static_cast<off_t>(count)) != 0)
+  {
+    if (!is_fallocate_unsupported(errno))
+    {
+      return file_error(file_op::write, m_fpath.c_str(), errno);
+    }
+
+    // The position has not been moved, so overwrite the range with zeros.
+    while (count > 0)
+    {
+      const size_t n = std::min(count, ZERO_BUFFER_SIZE);
+      result<void, file_error> ret = this->try_write(ZERO_BUFFER, n);
+      if (!ret)
+      {
+        return ret;
+      }
+      count -= n;
+    }
+    return {};
+  }
+
+  if (::lseek(fd, end, SEEK_SET) < 0)
+  {
+    return file_error(file_op::write, m_fpath.c_str(), errno);
+  }
+
+  return {};
+}
+
+result<size_t, file_error>
+file::try_read_vectored(struct iovec const * bufs, size_t count) noexcept
+{
+  const int fd = this->_fd();
+  ssize_t ret = transfer_all(
+    bufs,
+    count,
+    [fd](void * p, size_t n, size_t) { return ::read(fd, p, n); },
+    [fd](struct iovec const * iov, int iovcnt, size_t) {
+      return ::readv(fd, iov, iovcnt);
+    });
+  if (ret < 0)
+  {
+    return file_error(file_op::read, m_fpath.c_str(), errno);
+  }
+
+  return static_cast<size_t>(ret);
+}
+
+result<void, file_error>
+file::try_write_vectored(struct iovec const * bufs, size_t count) noexcept
+{
+  const int fd = this->_fd();
+  ssize_t ret = transfer_all(
+    bufs,
+    count,
+    [fd](void * p, size_t n, size_t) { return ::write(fd, p, n); },
+    [fd](struct iovec const * iov, int iovcnt, size_t) {
+      return ::writev(fd, iov, iovcnt);
+    });
+  if (ret < 0)
+  {
+    return file_error(file_op::write, m_fpath.c_str(), errno);
+  }
+
+  // `write` does not return 0 for a regular file unless nothing is asked to
+  // be written, but if it ever does, report it instead of looping forever.
+  if (static_cast<size_t>(ret) != total_size(bufs, count))
+  {
+    return file_error(file_op::write, m_fpath.c_str(), EIO);
+  }
+
+  return {};
+}
+
+result<size_t, file_error>
+file::try_pread(void * buf, size_t count, off_t offset) const noexcept
+{
+  struct iovec iov = {buf, count};
+  return this->try_pread_vectored(&iov, 1, offset);
+}
+
+result<void, file_error>
+file::try_pwrite(void const * buf, size_t count, off_t offset) noexcept
+{
+  struct iovec iov = {const_cast<void *>(buf), count};
+  return this->try_pwrite_vectored(&iov, 1, offset);
+}
+
+result<size_t, file_error>
+file::try_pread_vectored(
+  struct iovec const * bufs,
+  size_t count,
+  off_t offset) const noexcept
+{
+  const int fd = this->_fd();
+  ssize_t ret = transfer_all(
+    bufs,
+    count,
+    [fd, offset](void * p, size_t n, size_t done) {
+      return ::pread(fd, p, n, offset + static_cast<off_t>(done));
+    },
+    [fd, offset](struct iovec const * iov, int iovcnt, size_t done) {
+      return ::preadv(fd, iov, iovcnt, offset + static_cast<off_t>(done));
+    });
+  if (ret < 0)
+  {
+    return file_error(file_op::read, m_fpath.c_str(), errno);
+  }
+
+  return static_cast<size_t>(ret);
+}
+
+result<void, file_error>
+file::try_pwrite_vectored(
+  struct iovec const * bufs,
+  size_t count,
+  off_t offset) noexcept
+{
+  const int fd = this->_fd();
+  ssize_t ret = transfer_all(
+    bufs,
+    count,
+    [fd, offset](void * p, size_t n, size_t done) {
+      return ::pwrite(fd, p, n, offset + static_cast<off_t>(done));
+    },
+    [fd, offset](struct iovec const * iov, int iovcnt, size_t done) {
+      return ::pwritev(fd, iov, iovcnt, offset + static_cast<off_t>(done));
+    });
+  if (ret < 0)
+  {
+    return file_error(file_op::write, m_fpath.c_str(), errno);
+  }
+
+  // See `try_write_vectored`.
+  if (static_cast<size_t>(ret) != total_size(bufs, count))
+  {
+    return file_error(file_op::write, m_fpath.c_str(), EIO);
+  }
+
+  return {};
+}
+
+result<size_t, file_error>
+file::try_copy_to(
+  file & dst,
+  off_t offset,
+  size_t length,
+  copy_method method) noexcept
+{
+  const int in = this->_fd();
+  const int out = dst._fd();
+
+  if (copy_method::reflink == method)
+  {
+    const ssize_t ret = clone_range(in, out, offset, length);
+    if (ret < 0)
+    {
+      return file_error(
+        file_op::copy, m_fpath.c_str(), errno, dst.m_fpath.c_str());
+    }
+
+    if (ret > 0)
+    {
+      return static_cast<size_t>(ret);
+    }
+
+    method = copy_method::copy_file_range;
+  }
+
+  // Only allocated when we have to fall back to `copy_method::buffered`.
+  std::unique_ptr<char[]> buf;
+
+  size_t copied = 0;
+  while (copied < length)
+  {
+    const size_t chunk = std::min(length - copied, COPY_CHUNK_SIZE);
+    off_t in_offset = offset + static_cast<off_t>(copied);
+
+    ssize_t ret = 0;
+    switch (method)
+    {
+    case copy_method::copy_file_range:
+      ret = ::copy_file_range(in, &in_offset, out, nullptr, chunk, 0);
+      break;
+
+    case copy_method::sendfile:
+      ret = ::sendfile(out, in, &in_offset, chunk);
+      break;
+
+    default:
+      if (!buf)
+      {
+        buf.reset(new (std::nothrow) char[COPY_BUFFER_SIZE]);
+        if (!buf)
+        {
+          return file_error(
+            file_op::copy, m_fpath.c_str(), ENOMEM, dst.m_fpath.c_str());
+        }
+      }
+      ret = copy_buffered(
+        in,
+        out,
+        in_offset,
+        buf.get(),
+        std::min(chunk, COPY_BUFFER_SIZE));
+      break;
+    }
+
+    if (ret < 0)
+    {
+      if (EINTR == errno)
+      {
+        continue;
+      }
+
+      if (copy_method::buffered != method && is_copy_unsupported(errno))
+      {
+        method = static_cast<copy_method>(static_cast<int>(method) + 1);
+        continue;
+      }
+
+      return file_error(
+        file_op::copy, m_fpath.c_str(), errno, dst.m_fpath.c_str());
+    }
+
+    if (0 == ret)
+    {
+      break;  // The end of the file.
+    }
+
+    copied += static_cast<size_t>(ret);
+  }
+
+  return copied;
+}
+
+int
+file::_fd() const noexcept
+{
+  assert((nullptr != m_file));
+
+  return ::fileno(m_file);
 }
 
 }  // namespace ywen
@@ -1,11 +1,39 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdio>
 #include <string>
 
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "exception.hpp"
+#include "result.hpp"
+
 namespace ywen
 {
 
+/// The ways `file::copy_to` can copy data, from the fastest to the slowest.
+/// Each one falls back to the next one when the kernel or the file system
+/// does not support it.
+enum class copy_method : int
+{
+  /// Share the source's data blocks with the destination (`FICLONERANGE`),
+  /// which copies no data at all. Only possible on file systems such as
+  /// Btrfs and XFS, and only for block-aligned ranges.
+  reflink = 0,
+
+  /// Copy in the kernel with `copy_file_range`. The file system may still
+  /// decide to share the blocks.
+  copy_file_range = 1,
+
+  /// Copy in the kernel with `sendfile`.
+  sendfile = 2,
+
+  /// Read the data into a user space buffer and write it out.
+  buffered = 3,
+};
+
 class file
 {
 public:
@@ -18,15 +46,33 @@ public:
 
   ~file();
 
+  /// Throws:
+  /// - file_open_error:
   void
   open_read();
 
+  /// Create the file, or truncate it if it exists, for writing.
+  ///
+  /// If `expected_size` is not 0, that many bytes are allocated to the file
+  /// up front (`fallocate` with `FALLOC_FL_KEEP_SIZE`), so the file doesn't
+  /// have to grow block by block as it's written, which extends its
+  /// metadata on every write and fragments it. The size of the file is not
+  /// changed: it grows as the data is written, and `close` gives the blocks
+  /// beyond the end of the file back. The hint is ignored if the file system
+  /// can't allocate blocks up front.
+  ///
+  /// Throws:
+  /// - file_open_error: Including `ENOSPC` if `expected_size` bytes can't be
+  ///   allocated, in which case the file is left empty and closed.
   void
-  open_write();
+  open_write(size_t expected_size = 0);
 
   void
   open_append();
 
+  /// If the file was opened with an expected size, release the blocks
+  /// allocated beyond its end first (`ftruncate` to its size).
+  ///
   /// Throws:
   /// - file_close_error:
   void
@@ -35,9 +81,193 @@ public:
   bool
   is_open() const noexcept;
 
+  /// Return the path of the file.
+  std::string const &
+  fpath() const noexcept;
+
+  /// Return the current size of the opened file.
+  ///
+  /// Throws:
+  /// - file_read_error:
+  size_t
+  size() const;
+
+  // NOTE(ywen): All the data transfer functions below work on the file
+  // descriptor of the stream (i.e., `fileno(m_file)`) and never on the
+  // `std::FILE` buffer, so the sequential and the positional functions can
+  // be mixed freely. The `std::FILE` is only used to own the descriptor.
+
+  /// Read up to `count` bytes at the current file position into `buf`.
+  ///
+  /// Returns the number of bytes read, which is less than `count` only when
+  /// the end of the file is reached.
+  ///
+  /// Throws:
+  /// - file_read_error:
+  size_t
+  read(void * buf, size_t count);
+
+  /// Write all the `count` bytes in `buf` at the current file position.
+  ///
+  /// Throws:
+  /// - file_write_error:
+  void
+  write(void const * buf, size_t count);
+
+  /// Write `count` zero bytes at the current file position, without writing
+  /// (or allocating blocks for) them: the range is turned into a hole
+  /// (`FALLOC_FL_PUNCH_HOLE`), and the file is extended if the range goes
+  /// beyond its end. Falls back to writing zeros if the file system can't
+  /// punch holes.
+  ///
+  /// Throws:
+  /// - file_write_error:
+  void
+  write_zeroes(size_t count);
+
+  /// Scatter read: fill the `count` buffers in `bufs` in order, starting at
+  /// the current file position, with as few system calls (`readv`) as
+  /// possible.
+  ///
+  /// Returns the total number of bytes read, which is less than the total
+  /// size of the buffers only when the end of the file is reached.
+  ///
+  /// Throws:
+  /// - file_read_error:
+  size_t
+  read_vectored(struct iovec const * bufs, size_t count);
+
+  /// Gather write: write the `count` buffers in `bufs` in order, starting at
+  /// the current file position, with as few system calls (`writev`) as
+  /// possible. No intermediate buffer is used to concatenate them.
+  ///
+  /// Throws:
+  /// - file_write_error:
+  void
+  write_vectored(struct iovec const * bufs, size_t count);
+
+  /// Read up to `count` bytes at `offset` into `buf`. The file position is
+  /// neither used nor changed, so multiple threads can call this function on
+  /// the same `file` concurrently.
+  ///
+  /// Returns the number of bytes read, which is less than `count` only when
+  /// the end of the file is reached.
+  ///
+  /// Throws:
+  /// - file_read_error:
+  size_t
+  pread(void * buf, size_t count, off_t offset) const;
+
+  /// Write all the `count` bytes in `buf` at `offset`. The file position is
+  /// neither used nor changed, so multiple threads can call this function on
+  /// the same `file` concurrently.
+  ///
+  /// Throws:
+  /// - file_write_error:
+  void
+  pwrite(void const * buf, size_t count, off_t offset);
+
+  /// The positional version of `read_vectored` (`preadv`).
+  ///
+  /// Throws:
+  /// - file_read_error:
+  size_t
+  pread_vectored(struct iovec const * bufs, size_t count, off_t offset) const;
+
+  /// The positional version of `write_vectored` (`pwritev`).
+  ///
+  /// Throws:
+  /// - file_write_error:
+  void
+  pwrite_vectored(struct iovec const * bufs, size_t count, off_t offset);
+
+  /// Copy `length` bytes starting at `offset` of this file to the current
+  /// file position of `dst`, advancing the position of `dst`. The position
+  /// of this file is neither used nor changed.
+  ///
+  /// The copy starts with `method` and falls back to the slower methods when
+  /// `method` is not supported for the two files.
+  ///
+  /// Returns the number of bytes copied, which is less than `length` only
+  /// when the end of this file is reached.
+  ///
+  /// Throws:
+  /// - file_copy_error: `ENOMEM` if the buffer of `copy_method::buffered`
+  ///   can't be allocated.
+  size_t
+  copy_to(
+    file & dst,
+    off_t offset,
+    size_t length,
+    copy_method method = copy_method::reflink);
+
+  // The non-throwing versions of the functions above. Instead of throwing
+  // the exceptions listed above, they return the corresponding `file_error`
+  // (see `file_error::raise`), whose paths point into this `file` (and into
+  // `dst` for `try_copy_to`). The throwing versions are built on them.
+
+  result<void, file_error>
+  try_open_read() noexcept;
+
+  result<void, file_error>
+  try_open_write(size_t expected_size = 0) noexcept;
+
+  result<void, file_error>
+  try_close() noexcept;
+
+  result<size_t, file_error>
+  try_size() const noexcept;
+
+  result<size_t, file_error>
+  try_read(void * buf, size_t count) noexcept;
+
+  result<void, file_error>
+  try_write(void const * buf, size_t count) noexcept;
+
+  result<void, file_error>
+  try_write_zeroes(size_t count) noexcept;
+
+  result<size_t, file_error>
+  try_read_vectored(struct iovec const * bufs, size_t count) noexcept;
+
+  result<void, file_error>
+  try_write_vectored(struct iovec const * bufs, size_t count) noexcept;
+
+  result<size_t, file_error>
+  try_pread(void * buf, size_t count, off_t offset) const noexcept;
+
+  result<void, file_error>
+  try_pwrite(void const * buf, size_t count, off_t offset) noexcept;
+
+  result<size_t, file_error>
+  try_pread_vectored(struct iovec const * bufs, size_t count, off_t offset)
+    const noexcept;
+
+  result<void, file_error>
+  try_pwrite_vectored(
+    struct iovec const * bufs,
+    size_t count,
+    off_t offset) noexcept;
+
+  result<size_t, file_error>
+  try_copy_to(
+    file & dst,
+    off_t offset,
+    size_t length,
+    copy_method method = copy_method::reflink) noexcept;
+
+private:
+  /// Return the file descriptor of the opened file.
+  int
+  _fd() const noexcept;
+
 private:
   std::string m_fpath;
   std::FILE * m_file;
+
+  /// Whether blocks were allocated beyond the end of the file when it was
+  /// opened, which `close` releases.
+  bool m_preallocated;
 };
 
 }  // namespace ywen
@@ -0,0 +1,194 @@
+#include <cassert>
+#include <cerrno>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "file_batch.hpp"
+
+namespace ywen
+{
+
+namespace
+{
+
+/// The number of files a task gets sizes for or reads. A task is much
+/// cheaper than opening a file, so the grains are small to balance the load
+/// when the file sizes vary.
+constexpr size_t STAT_GRAIN = 64;
+constexpr size_t READ_GRAIN = 8;
+
+}  // namespace
+
+file_batch::file_batch(std::vector<std::string> fpaths)
+  : m_fpaths(std::move(fpaths)),
+    m_entries(m_fpaths.size(), _entry{0, 0, file_op::open, 0}),
+    m_arena_size(0)
+{
+  // Empty
+}
+
+void
+file_batch::read_all(thread_pool & pool)
+{
+  pool.parallel_for(
+    0, m_fpaths.size(), STAT_GRAIN, [this](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i)
+      {
+        this->_stat(i);
+      }
+    });
+
+  // Lay the files out in the arena in order.
+  size_t total = 0;
+  for (_entry & entry : m_entries)
+  {
+    entry.offset = total;
+    total += entry.size;
+  }
+
+  if (total > m_arena_size || !m_arena)
+  {
+    // The arena is not zeroed; every byte of it is read into.
+    m_arena.reset(new char[total > 0 ? total : 1]);
+  }
+  m_arena_size = total;
+
+  pool.parallel_for(
+    0, m_fpaths.size(), READ_GRAIN, [this](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i)
+      {
+        this->_read(i);
+      }
+    });
+}
+
+size_t
+file_batch::size() const noexcept
+{
+  return m_fpaths.size();
+}
+
+std::string const &
+file_batch::fpath(size_t i) const noexcept
+{
+  assert((i < m_fpaths.size()));
+  return m_fpaths[i];
+}
+
+result<std::string_view, file_error>
+file_batch::get(size_t i) const noexcept
+{
+  assert((i < m_entries.size()));
+
+  _entry const & entry = m_entries[i];
+  if (entry.err_no != 0)
+  {
+    return file_error(entry.op, m_fpaths[i].c_str(), entry.err_no);
+  }
+
+  return std::string_view(m_arena.get() + entry.offset, entry.size);
+}
+
+std::string_view
+file_batch::at(size_t i) const
+{
+  result<std::string_view, file_error> r = this->get(i);
+  if (!r)
+  {
+    r.error().raise();
+  }
+
+  return r.value();
+}
+
+size_t
+file_batch::arena_size() const noexcept
+{
+  return m_arena_size;
+}
+
+void
+file_batch::_stat(size_t i) noexcept
+{
+  _entry & entry = m_entries[i];
+  entry = _entry{0, 0, file_op::open, 0};
+
+  struct stat st;
+  if (::stat(m_fpaths[i].c_str(), &st) != 0)
+  {
+    entry.err_no = errno;
+    return;
+  }
+
+  if (S_ISDIR(st.st_mode))
+  {
+    // `open` opens a directory for reading; `read` is what fails.
+    entry.op = file_op::read;
+    entry.err_no = EISDIR;
+    return;
+  }
+
+  entry.size = static_cast<size_t>(st.st_size);
+}
+
+void
+file_batch::_read(size_t i) noexcept
+{
+  _entry & entry = m_entries[i];
+  if (entry.err_no != 0)
+  {
+    return;
+  }
+
+  // Raw descriptors rather than `file`, which would copy the path and
+  // allocate a `std::FILE` for every file.
+  const int fd = ::open(m_fpaths[i].c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+  {
+    entry.size = 0;
+    entry.op = file_op::open;
+    entry.err_no = errno;
+    return;
+  }
+
+  // The file may have shrunk since `_stat`, so only the bytes that are read
+  // are kept.
+  size_t done = 0;
+  while (done < entry.size)
+  {
+    const ssize_t n = ::pread(
+      fd,
+      m_arena.get() + entry.offset + done,
+      entry.size - done,
+      static_cast<off_t>(done));
+    if (n < 0)
+    {
+      if (EINTR == errno)
+      {
+        continue;
+      }
+
+      entry.size = 0;
+      entry.op = file_op::read;
+      entry.err_no = errno;
+      ::close(fd);
+      return;
+    }
+
+    if (0 == n)
+    {
+      break;  // The end of the file.
+    }
+
+    done += static_cast<size_t>(n);
+  }
+  entry.size = done;
+
+  // A failure to close a file that is only read loses no data.
+  ::close(fd);
+}
+
+}  // namespace ywen
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../thread_pool/thread_pool.hpp"
+#include "exception.hpp"
+#include "result.hpp"
+
+namespace ywen
+{
+
+/// Load many (e.g., tens of thousands of) small files into memory in
+/// parallel.
+///
+/// The files are read in two parallel passes on a `thread_pool`: the first
+/// one gets the file sizes, and the second one reads every file into its
+/// own slice of one contiguous buffer (the "arena"), so loading a batch
+/// allocates the same few blocks of memory no matter how many files it has.
+///
+/// A file that can't be read does not stop the batch: its error is kept and
+/// returned by `get` (or thrown by `at`), and the other files are read as
+/// usual.
+class file_batch
+{
+public:
+  /// Throws:
+  /// - `std::bad_alloc`: When out of memory.
+  explicit file_batch(std::vector<std::string> fpaths);
+
+  file_batch(file_batch const &) = delete;
+
+  file_batch &
+  operator=(file_batch const &) = delete;
+
+  /// Read all the files on `pool`. At most `pool.size() + 1` files (the
+  /// worker threads plus the calling thread) are open at the same time.
+  /// Calling it again reloads all the files.
+  ///
+  /// A file that grows between the two passes is truncated to its size in
+  /// the first pass.
+  ///
+  /// Throws:
+  /// - `std::bad_alloc`: When out of memory. The errors of the files are
+  ///   not thrown.
+  void
+  read_all(thread_pool & pool);
+
+  /// Return the number of files.
+  size_t
+  size() const noexcept;
+
+  /// Return the path of the `i`-th file.
+  std::string const &
+  fpath(size_t i) const noexcept;
+
+  /// Return the content of the `i`-th file, or the error that happened when
+  /// it was read. The content and the paths of the error point into this
+  /// batch. `read_all` must have been called.
+  result<std::string_view, file_error>
+  get(size_t i) const noexcept;
+
+  /// The throwing version of `get`.
+  ///
+  /// Throws:
+  /// - file_open_error:
+  /// - file_read_error:
+  std::string_view
+  at(size_t i) const;
+
+  /// Return the total size of the files that have been read.
+  size_t
+  arena_size() const noexcept;
+
+private:
+  /// Where a file is in the arena, or how reading it failed.
+  struct _entry
+  {
+    size_t offset;
+    size_t size;
+    file_op op;
+    int err_no;
+  };
+
+  /// Get the size of the `i`-th file.
+  void
+  _stat(size_t i) noexcept;
+
+  /// Read the `i`-th file into its slice of the arena.
+  void
+  _read(size_t i) noexcept;
+
+private:
+  std::vector<std::string> m_fpaths;
+  std::vector<_entry> m_entries;
+  std::unique_ptr<char[]> m_arena;
+  size_t m_arena_size;
+};
+
+}  // namespace ywen
@@ -0,0 +1,168 @@
+#include <cassert>
+
+#include "file_reader.hpp"
+
+namespace ywen
+{
+
+namespace
+{
+
+/// The number of times a side checks the ring (yielding in between) before
+/// it goes to sleep. A buffer is usually filled or consumed soon, and
+/// sleeping costs two system calls.
+constexpr int SPIN_COUNT = 64;
+
+}  // namespace
+
+file_reader::file_reader(
+  file const & f,
+  size_t buffer_count,
+  size_t buffer_size,
+  off_t offset)
+  : m_file(f),
+    m_buffer_count(buffer_count),
+    m_buffer_size(buffer_size),
+    m_offset(offset),
+    m_buffers(new char[buffer_count * buffer_size]),
+    m_slots(new _slot[buffer_count]),
+    m_filled(0),
+    m_released(0),
+    m_holding(false),
+    m_stop(false),
+    m_consumer_waiting(false),
+    m_producer_waiting(false)
+{
+  assert((buffer_count > 0));
+  assert((buffer_size > 0));
+  assert((f.is_open()));
+
+  m_thread = std::thread(&file_reader::_produce, this);
+}
+
+file_reader::~file_reader() noexcept
+{
+  m_stop.store(true);
+  this->_notify(m_producer_waiting, m_released_cv);
+  m_thread.join();
+}
+
+std::string_view
+file_reader::next()
+{
+  if (m_holding)
+  {
+    m_holding = false;
+    m_released.fetch_add(1);
+    this->_notify(m_producer_waiting, m_released_cv);
+  }
+
+  const size_t n = m_released.load(std::memory_order_relaxed);
+  this->_wait(m_consumer_waiting, m_filled_cv, [this, n]() {
+    return m_filled.load() > n;
+  });
+
+  _slot const & slot = m_slots[n % m_buffer_count];
+  if (slot.failed)
+  {
+    // The background thread has stopped, so the slot is kept and every
+    // following call throws the same error.
+    slot.error.raise();
+  }
+
+  // Likewise, the empty slot at the end of the file is kept.
+  m_holding = (slot.size > 0);
+
+  return std::string_view(
+    m_buffers.get() + (n % m_buffer_count) * m_buffer_size, slot.size);
+}
+
+void
+file_reader::_produce() noexcept
+{
+  off_t offset = m_offset;
+
+  for (size_t n = 0;; ++n)
+  {
+    this->_wait(m_producer_waiting, m_released_cv, [this, n]() {
+      return m_stop.load() || n - m_released.load() < m_buffer_count;
+    });
+    if (m_stop.load())
+    {
+      return;
+    }
+
+    _slot & slot = m_slots[n % m_buffer_count];
+    result<size_t, file_error> r = m_file.try_pread(
+      m_buffers.get() + (n % m_buffer_count) * m_buffer_size,
+      m_buffer_size,
+      offset);
+
+    // `slot` belongs to the caller after it is published.
+    const bool last = (!r || 0 == r.value());
+    if (r)
+    {
+      slot.size = r.value();
+      slot.failed = false;
+      offset += static_cast<off_t>(r.value());
+    }
+    else
+    {
+      slot.size = 0;
+      slot.failed = true;
+      slot.error = r.error();
+    }
+
+    m_filled.store(n + 1);
+    this->_notify(m_consumer_waiting, m_filled_cv);
+
+    if (last)
+    {
+      return;
+    }
+  }
+}
+
+template<typename _Ready>
+void
+file_reader::_wait(
+  std::atomic<bool> & waiting,
+  std::condition_variable & cv,
+  _Ready ready) noexcept
+{
+  for (int i = 0; i < SPIN_COUNT; ++i)
+  {
+    if (ready())
+    {
+      return;
+    }
+    std::this_thread::yield();
+  }
+
+  // `waiting` is set before `ready()` is checked again, and the other side
+  // updates the ring before it checks `waiting` (both sequentially
+  // consistent), so at least one of them sees the other's store and the
+  // wake-up can't be lost.
+  std::unique_lock<std::mutex> lock(m_mutex);
+  waiting.store(true);
+  cv.wait(lock, ready);
+  waiting.store(false);
+}
+
+void
+file_reader::_notify(
+  std::atomic<bool> & waiting,
+  std::condition_variable & cv) noexcept
+{
+  if (waiting.load())
+  {
+    // Taking the mutex makes sure the waiting side is either before its
+    // last check of `ready()` or asleep in `cv.wait`.
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+    }
+    cv.notify_one();
+  }
+}
+
+}  // namespace ywen
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+
+#include <sys/types.h>
+
+#include "exception.hpp"
+#include "file.hpp"
+
+namespace ywen
+{
+
+/// Scan a file sequentially with readahead: a background thread reads the
+/// next buffers of the file while the caller processes the current one, so
+/// waiting for the disk and computing overlap.
+///
+/// The buffers are handed over through a bounded single-producer,
+/// single-consumer ring: the background thread fills the buffers in order
+/// and the caller consumes them in the same order, and neither side takes a
+/// lock unless it has to wait (i.e., the ring is empty or full).
+///
+/// When reading fails, the background thread stops, and the error is thrown
+/// to the caller when it reaches the failed buffer; the buffers read before
+/// it are still returned.
+class file_reader
+{
+public:
+  /// Start reading `f` from `offset` to the end, with `buffer_count`
+  /// buffers of `buffer_size` bytes each (both must be at least 1). `f`
+  /// must be open for reading and outlive the reader. Only the positional
+  /// reads are used, so the position of `f` is not changed.
+  ///
+  /// Throws:
+  /// - `std::bad_alloc`: When out of memory.
+  /// - `std::system_error`: When the background thread can't be started.
+  file_reader(
+    file const & f,
+    size_t buffer_count = 4,
+    size_t buffer_size = 1U << 20,
+    off_t offset = 0);
+
+  file_reader(file_reader const &) = delete;
+
+  file_reader &
+  operator=(file_reader const &) = delete;
+
+  /// Stop and join the background thread, even if the file has not been
+  /// read to the end.
+  ~file_reader() noexcept;
+
+  /// Return the next chunk of the file, which is at most `buffer_size`
+  /// bytes, or an empty chunk at the end of the file. The chunk is valid
+  /// until the next call.
+  ///
+  /// Throws:
+  /// - file_read_error: The error of reading the chunk.
+  std::string_view
+  next();
+
+private:
+  struct _slot
+  {
+    size_t size = 0;
+    bool failed = false;
+    file_error error = file_error(file_op::read, nullptr, 0);
+  };
+
+  /// The loop of the background thread.
+  void
+  _produce() noexcept;
+
+  /// Wait until `ready()` returns true. `waiting` tells the other side to
+  /// notify `cv`.
+  template<typename _Ready>
+  void
+  _wait(
+    std::atomic<bool> & waiting,
+    std::condition_variable & cv,
+    _Ready ready) noexcept;
+
+  /// Wake up the other side if it waits on `cv`.
+  void
+  _notify(std::atomic<bool> & waiting, std::condition_variable & cv) noexcept;
+
+private:
+  file const & m_file;
+  const size_t m_buffer_count;
+  const size_t m_buffer_size;
+  const off_t m_offset;
+
+  std::unique_ptr<char[]> m_buffers;
+  std::unique_ptr<_slot[]> m_slots;
+
+  /// The number of buffers filled by the background thread and the number
+  /// of buffers released by the caller. They are on their own cache lines
+  /// because each one is written by one side and read by the other.
+  alignas(64) std::atomic<size_t> m_filled;
+  alignas(64) std::atomic<size_t> m_released;
+
+  /// Whether the caller holds the buffer `m_released % m_buffer_count`.
+  bool m_holding;
+
+  /// Set by the destructor to stop the background thread.
+  std::atomic<bool> m_stop;
+
+  /// Only used to sleep when the ring is empty (the caller) or full (the
+  /// background thread).
+  std::mutex m_mutex;
+  std::condition_variable m_filled_cv;
+  std::condition_variable m_released_cv;
+  std::atomic<bool> m_consumer_waiting;
+  std::atomic<bool> m_producer_waiting;
+
+  std::thread m_thread;
+};
+
+}  // namespace ywen
@@ -1,6 +1,1166 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "codec.hpp"
+#include "compressed_file.hpp"
+#include "crc32c.hpp"
+#include "exception.hpp"
+#include "file.hpp"
+#include "file_batch.hpp"
+#include "file_reader.hpp"
+#include "vector_io.hpp"
+
+using ywen::file;
+
+namespace
+{
+
+/// Return a path in the test's temporary directory that does not exist.
+std::string
+temp_path(std::string const & name)
+{
+  std::string fpath = testing::TempDir() + "ywen_file_" + name;
+  std::remove(fpath.c_str());
+  return fpath;
+}
+
+/// Return the number of bytes of disk space allocated to `fpath`.
+size_t
+allocated_size(std::string const & fpath)
+{
+  struct stat st;
+  EXPECT_EQ(0, ::stat(fpath.c_str(), &st));
+  return static_cast<size_t>(st.st_blocks) * 512;
+}
+
+}  // namespace
+
 TEST(TestFile, test_dummy)
 {
   // Empty
 }
+
+TEST(TestFile, test_open_read_not_found)
+{
+  file f(temp_path("not_found"));
+
+  try
+  {
+    f.open_read();
+    FAIL() << "file_open_error is not thrown";
+  }
+  catch (ywen::file_open_error const & e)
+  {
+    EXPECT_EQ(ENOENT, e.err_no());
+  }
+
+  EXPECT_FALSE(f.is_open());
+}
+
+TEST(TestFile, test_write_read)
+{
+  const std::string fpath = temp_path("write_read");
+  const char data[] = "0123456789";
+
+  {
+    file f(fpath);
+    f.open_write();
+    EXPECT_TRUE(f.is_open());
+    f.write(data, 10);
+    f.close();
+    EXPECT_FALSE(f.is_open());
+  }
+
+  {
+    file f(fpath);
+    f.open_read();
+
+    char buf[16] = {};
+    EXPECT_EQ(4U, f.read(buf, 4));
+    EXPECT_EQ(0, std::memcmp(buf, "0123", 4));
+    // Reading beyond the end of the file returns what is left.
+    EXPECT_EQ(6U, f.read(buf, sizeof(buf)));
+    EXPECT_EQ(0, std::memcmp(buf, "456789", 6));
+    EXPECT_EQ(0U, f.read(buf, sizeof(buf)));
+  }
+}
+
+TEST(TestFile, test_vectored)
+{
+  const std::string fpath = temp_path("vectored");
+
+  {
+    char header[] = "HDR:";
+    char payload[] = "payload";
+    char trailer[] = ":END";
+
+    struct iovec bufs[] = {
+      {header, 4},
+      {nullptr, 0},  // Empty buffers are allowed.
+      {payload, 7},
+      {trailer, 4},
+    };
+
+    file f(fpath);
+    f.open_write();
+    f.write_vectored(bufs, 4);
+  }
+
+  {
+    // Split the data differently from how it was written.
+    char a[2] = {};
+    char b[10] = {};
+    char c[8] = {};
+
+    struct iovec bufs[] = {{a, sizeof(a)}, {b, sizeof(b)}, {c, sizeof(c)}};
+
+    file f(fpath);
+    f.open_read();
+    EXPECT_EQ(15U, f.read_vectored(bufs, 3));
+    EXPECT_EQ(0, std::memcmp(a, "HD", 2));
+    EXPECT_EQ(0, std::memcmp(b, "R:payload:", 10));
+    EXPECT_EQ(0, std::memcmp(c, "END", 3));
+  }
+}
+
+TEST(TestFile, test_positional)
+{
+  const std::string fpath = temp_path("positional");
+
+  {
+    file f(fpath);
+    f.open_write();
+    f.pwrite("world", 5, 6);
+    f.pwrite("hello ", 6, 0);
+
+    // The positional writes do not move the file position.
+    f.write("HELLO", 5);
+  }
+
+  file f(fpath);
+  f.open_read();
+
+  char buf[16] = {};
+  EXPECT_EQ(5U, f.pread(buf, 5, 6));
+  EXPECT_EQ(0, std::memcmp(buf, "world", 5));
+
+  char a[3] = {};
+  char b[3] = {};
+  struct iovec bufs[] = {{a, sizeof(a)}, {b, sizeof(b)}};
+  EXPECT_EQ(5U, f.pread_vectored(bufs, 2, 6));
+  EXPECT_EQ(0, std::memcmp(a, "wor", 3));
+  EXPECT_EQ(0, std::memcmp(b, "ld", 2));
+
+  // The positional reads do not move the file position either.
+  EXPECT_EQ(11U, f.read(buf, sizeof(buf)));
+  EXPECT_EQ(0, std::memcmp(buf, "HELLO world", 11));
+
+  EXPECT_EQ(0U, f.pread(buf, sizeof(buf), 100));
+}
+
+TEST(TestFile, test_positional_concurrent)
+{
+  const std::string fpath = temp_path("positional_concurrent");
+  const size_t N = 8;
+  const size_t BLOCK = 4096;
+
+  {
+    file f(fpath);
+    f.open_write();
+
+    std::vector<std::thread> writers;
+    for (size_t i = 0; i < N; ++i)
+    {
+      writers.emplace_back([&f, i]() {
+        std::vector<char> block(BLOCK, static_cast<char>('a' + i));
+        f.pwrite(block.data(), block.size(), static_cast<off_t>(i * BLOCK));
+      });
+    }
+    for (std::thread & t : writers)
+    {
+      t.join();
+    }
+  }
+
+  file f(fpath);
+  f.open_read();
+
+  std::vector<int> ok(N, 0);
+  std::vector<std::thread> readers;
+  for (size_t i = 0; i < N; ++i)
+  {
+    readers.emplace_back([&f, &ok, i]() {
+      std::vector<char> block(BLOCK);
+      size_t n =
+        f.pread(block.data(), block.size(), static_cast<off_t>(i * BLOCK));
+      ok[i] = (BLOCK == n) &&
+        (std::vector<char>(BLOCK, static_cast<char>('a' + i)) == block);
+    });
+  }
+  for (std::thread & t : readers)
+  {
+    t.join();
+  }
+
+  for (size_t i = 0; i < N; ++i)
+  {
+    EXPECT_TRUE(ok[i]) << "block " << i;
+  }
+}
+
+TEST(TestFile, test_open_write_preallocate)
+{
+  const std::string fpath = temp_path("preallocate");
+  const size_t EXPECTED = 4U << 20;
+  const std::vector<char> data(EXPECTED / 4, 'p');
+
+  file f(fpath);
+  f.open_write(EXPECTED);
+
+  // The blocks are allocated, but the file is still empty.
+  EXPECT_GE(allocated_size(fpath), EXPECTED);
+  EXPECT_EQ(0U, f.size());
+
+  f.write(data.data(), data.size());
+  EXPECT_EQ(data.size(), f.size());
+
+  // Closing gives back the blocks that were not written.
+  f.close();
+  EXPECT_GE(allocated_size(fpath), data.size());
+  EXPECT_LT(allocated_size(fpath), EXPECTED);
+
+  f.open_read();
+  std::vector<char> buf(EXPECTED);
+  EXPECT_EQ(data.size(), f.read(buf.data(), buf.size()));
+  buf.resize(data.size());
+  EXPECT_EQ(data, buf);
+}
+
+TEST(TestFile, test_write_zeroes)
+{
+  const std::string fpath = temp_path("write_zeroes");
+  const size_t HOLE = 1U << 20;
+  const std::vector<char> data(HOLE, 'z');
+
+  {
+    file f(fpath);
+    f.open_write(4 * HOLE);
+
+    // A hole in the middle of the file, and one that extends it.
+    f.write(data.data(), data.size());
+    f.write_zeroes(HOLE);
+    f.write(data.data(), data.size());
+    f.write_zeroes(0);
+    f.write_zeroes(HOLE);
+    EXPECT_EQ(4 * HOLE, f.size());
+  }
+
+  {
+    file f(fpath);
+    f.open_read();
+    EXPECT_EQ(4 * HOLE, f.size());
+
+    std::vector<char> buf(HOLE);
+    const std::vector<char> zeroes(HOLE, '\0');
+    EXPECT_EQ(HOLE, f.read(buf.data(), HOLE));
+    EXPECT_EQ(data, buf);
+    EXPECT_EQ(HOLE, f.read(buf.data(), HOLE));
+    EXPECT_EQ(zeroes, buf);
+    EXPECT_EQ(HOLE, f.read(buf.data(), HOLE));
+    EXPECT_EQ(data, buf);
+    EXPECT_EQ(HOLE, f.read(buf.data(), HOLE));
+    EXPECT_EQ(zeroes, buf);
+  }
+
+  // The holes take no disk space.
+  EXPECT_LT(allocated_size(fpath), 3 * HOLE);
+}
+
+TEST(TestFile, test_write_to_read_only)
+{
+  const std::string fpath = temp_path("read_only");
+
+  {
+    file f(fpath);
+    f.open_write();
+  }
+
+  file f(fpath);
+  f.open_read();
+  EXPECT_THROW(f.write("x", 1), ywen::file_write_error);
+  EXPECT_THROW(f.pwrite("x", 1, 0), ywen::file_write_error);
+}
+
+TEST(TestFile, test_copy_to)
+{
+  const std::string src_fpath = temp_path("copy_src");
+  const size_t SIZE = 3 * 1024 * 1024 + 17;
+
+  std::vector<char> data(SIZE);
+  for (size_t i = 0; i < SIZE; ++i)
+  {
+    data[i] = static_cast<char>(i * 7 + i / 4096);
+  }
+
+  {
+    file f(src_fpath);
+    f.open_write();
+    f.write(data.data(), data.size());
+  }
+
+  const ywen::copy_method methods[] = {
+    ywen::copy_method::reflink,
+    ywen::copy_method::copy_file_range,
+    ywen::copy_method::sendfile,
+    ywen::copy_method::buffered,
+  };
+
+  for (ywen::copy_method method : methods)
+  {
+    const std::string dst_fpath = temp_path("copy_dst");
+
+    {
+      file src(src_fpath);
+      src.open_read();
+
+      file dst(dst_fpath);
+      dst.open_write();
+      dst.write("head", 4);
+
+      // A whole-file copy followed by a copy that runs beyond the end of the
+      // source file.
+      EXPECT_EQ(SIZE, src.copy_to(dst, 0, SIZE, method));
+      EXPECT_EQ(17U, src.copy_to(dst, SIZE - 17, 4096, method));
+      EXPECT_EQ(0U, src.copy_to(dst, SIZE, 4096, method));
+
+      // The position of the source file is not changed.
+      char buf[4] = {};
+      EXPECT_EQ(4U, src.read(buf, 4));
+      EXPECT_EQ(0, std::memcmp(buf, data.data(), 4));
+    }
+
+    file dst(dst_fpath);
+    dst.open_read();
+
+    std::vector<char> copied(4 + SIZE + 17 + 1);
+    ASSERT_EQ(4 + SIZE + 17, dst.read(copied.data(), copied.size()))
+      << "method " << static_cast<int>(method);
+    EXPECT_EQ(0, std::memcmp(copied.data(), "head", 4));
+    EXPECT_EQ(0, std::memcmp(copied.data() + 4, data.data(), SIZE));
+    EXPECT_EQ(0, std::memcmp(copied.data() + 4 + SIZE, &data[SIZE - 17], 17));
+  }
+}
+
+TEST(TestFile, test_copy_to_read_only)
+{
+  const std::string src_fpath = temp_path("copy_ro_src");
+  const std::string dst_fpath = temp_path("copy_ro_dst");
+
+  {
+    file src(src_fpath);
+    src.open_write();
+    src.write("data", 4);
+
+    file dst(dst_fpath);
+    dst.open_write();
+  }
+
+  file src(src_fpath);
+  src.open_read();
+
+  file dst(dst_fpath);
+  dst.open_read();
+
+  try
+  {
+    src.copy_to(dst, 0, 4);
+    FAIL() << "file_copy_error is not thrown";
+  }
+  catch (ywen::file_copy_error const & e)
+  {
+    EXPECT_EQ(src_fpath, e.fpath());
+    EXPECT_EQ(dst_fpath, e.dst_fpath());
+    EXPECT_EQ(EBADF, e.err_no());
+  }
+}
+
+TEST(TestFile, test_result)
+{
+  {
+    ywen::result<size_t, ywen::file_error> r(size_t(10));
+    EXPECT_TRUE(r.has_value());
+    EXPECT_TRUE(static_cast<bool>(r));
+    EXPECT_EQ(10U, r.value());
+  }
+
+  {
+    ywen::result<std::string, ywen::file_error> r(std::string("abc"));
+    ywen::result<std::string, ywen::file_error> copied(r);
+    ywen::result<std::string, ywen::file_error> moved(std::move(r));
+    EXPECT_EQ("abc", copied.value());
+    EXPECT_EQ("abc", moved.value());
+  }
+
+  {
+    ywen::result<size_t, ywen::file_error> r(
+      ywen::file_error(ywen::file_op::read, "path", EIO));
+    EXPECT_FALSE(r.has_value());
+    EXPECT_EQ(ywen::file_op::read, r.error().op());
+    EXPECT_STREQ("path", r.error().fpath());
+    EXPECT_EQ(EIO, r.error().err_no());
+    EXPECT_EQ(nullptr, r.error().dst_fpath());
+  }
+
+  {
+    ywen::result<void, ywen::file_error> ok;
+    EXPECT_TRUE(ok.has_value());
+
+    ywen::result<void, ywen::file_error> r(
+      ywen::file_error(ywen::file_op::close, "path", EBADF));
+    EXPECT_FALSE(r.has_value());
+    EXPECT_EQ(EBADF, r.error().err_no());
+  }
+}
+
+TEST(TestFile, test_file_error_raise)
+{
+  using ywen::file_error;
+  using ywen::file_op;
+
+  EXPECT_THROW(
+    file_error(file_op::open, "p", ENOENT).raise(), ywen::file_open_error);
+  EXPECT_THROW(
+    file_error(file_op::close, "p", EIO).raise(), ywen::file_close_error);
+  EXPECT_THROW(
+    file_error(file_op::read, "p", EIO).raise(), ywen::file_read_error);
+  EXPECT_THROW(
+    file_error(file_op::write, "p", EIO).raise(), ywen::file_write_error);
+
+  try
+  {
+    file_error(file_op::copy, "src", EXDEV, "dst").raise();
+    FAIL() << "file_copy_error is not thrown";
+  }
+  catch (ywen::file_copy_error const & e)
+  {
+    EXPECT_STREQ("src", e.fpath());
+    EXPECT_STREQ("dst", e.dst_fpath());
+    EXPECT_EQ(EXDEV, e.err_no());
+  }
+}
+
+TEST(TestFile, test_try_open_read_not_found)
+{
+  const std::string fpath = temp_path("try_not_found");
+  file f(fpath);
+
+  auto r = f.try_open_read();
+  ASSERT_FALSE(r.has_value());
+  EXPECT_EQ(ywen::file_op::open, r.error().op());
+  EXPECT_EQ(ENOENT, r.error().err_no());
+  EXPECT_EQ(fpath, r.error().fpath());
+  EXPECT_FALSE(f.is_open());
+}
+
+TEST(TestFile, test_try_read_write)
+{
+  const std::string fpath = temp_path("try_read_write");
+
+  {
+    file f(fpath);
+    ASSERT_TRUE(f.try_open_write().has_value());
+    EXPECT_TRUE(f.try_write("abcdef", 6).has_value());
+    EXPECT_TRUE(f.try_pwrite("XY", 2, 1).has_value());
+    EXPECT_TRUE(f.try_close().has_value());
+  }
+
+  file f(fpath);
+  ASSERT_TRUE(f.try_open_read().has_value());
+
+  char buf[8] = {};
+  auto r = f.try_read(buf, sizeof(buf));
+  ASSERT_TRUE(r.has_value());
+  EXPECT_EQ(6U, r.value());
+  EXPECT_EQ(0, std::memcmp(buf, "aXYdef", 6));
+
+  auto w = f.try_write("x", 1);
+  ASSERT_FALSE(w.has_value());
+  EXPECT_EQ(ywen::file_op::write, w.error().op());
+  EXPECT_EQ(EBADF, w.error().err_no());
+}
+
+TEST(TestFile, test_exception_no_allocation)
+{
+  static_assert(
+    std::is_nothrow_copy_constructible<ywen::file_open_error>::value, "");
+  static_assert(
+    std::is_nothrow_copy_constructible<ywen::file_copy_error>::value, "");
+  static_assert(
+    std::is_nothrow_constructible<
+      ywen::file_open_error,
+      char const *,
+      int>::value,
+    "");
+
+  ywen::file_open_error e("/tmp/a.txt", ENOENT);
+  EXPECT_STREQ("/tmp/a.txt", e.fpath());
+  EXPECT_FALSE(e.fpath_truncated());
+  EXPECT_EQ(ENOENT, e.err_no());
+  EXPECT_STREQ(
+    "failed to open '/tmp/a.txt': No such file or directory (errno 2)",
+    e.what());
+
+  // A copy has its own path buffer.
+  ywen::file_open_error copied(e);
+  EXPECT_STREQ("/tmp/a.txt", copied.fpath());
+  EXPECT_NE(e.fpath(), copied.fpath());
+
+  ywen::file_close_error c("/tmp/b.txt", EOF, EIO);
+  EXPECT_EQ(EOF, c.fclose_ret());
+  EXPECT_STREQ(
+    "failed to close '/tmp/b.txt': Input/output error (errno 5)", c.what());
+
+  ywen::file_copy_error cp("/tmp/a", "/mnt/b", ENOSPC);
+  EXPECT_STREQ(
+    "failed to copy '/tmp/a' to '/mnt/b': No space left on device (errno 28)",
+    cp.what());
+
+  // `what()` is also available through the `std::exception` interface.
+  std::exception const & base = cp;
+  EXPECT_STREQ(cp.what(), base.what());
+}
+
+TEST(TestFile, test_exception_long_path)
+{
+  const size_t CAPACITY = ywen::file_error_base::PATH_CAPACITY;
+
+  std::string fpath = "/" + std::string(CAPACITY * 2, 'd') + "/name.txt";
+
+  ywen::file_read_error e(fpath.c_str(), EIO);
+  EXPECT_TRUE(e.fpath_truncated());
+  EXPECT_EQ(CAPACITY - 1, std::strlen(e.fpath()));
+  EXPECT_EQ(0, std::strncmp("...", e.fpath(), 3));
+  EXPECT_EQ(fpath.substr(fpath.size() - (CAPACITY - 4)), e.fpath() + 3);
+
+  // The longest path that fits.
+  fpath = std::string(CAPACITY - 1, 'p');
+  ywen::file_write_error w(fpath.c_str(), EIO);
+  EXPECT_FALSE(w.fpath_truncated());
+  EXPECT_EQ(fpath, w.fpath());
+}
+
+TEST(TestFile, test_file_batch)
+{
+  const size_t COUNT = 300;
+
+  std::vector<std::string> fpaths;
+  std::vector<std::string> contents;
+  for (size_t i = 0; i < COUNT; ++i)
+  {
+    fpaths.push_back(temp_path("batch_" + std::to_string(i)));
+    // Include empty files.
+    contents.push_back(std::string(i % 7, static_cast<char>('a' + i % 26)));
+
+    file f(fpaths.back());
+    f.open_write();
+    f.write(contents.back().data(), contents.back().size());
+  }
+
+  // A missing file and a directory fail without stopping the batch.
+  fpaths.insert(fpaths.begin() + 100, temp_path("batch_not_found"));
+  fpaths.push_back(testing::TempDir());
+
+  ywen::file_batch batch(fpaths);
+  ywen::thread_pool pool(3);
+  batch.read_all(pool);
+
+  ASSERT_EQ(COUNT + 2, batch.size());
+
+  size_t total = 0;
+  for (size_t i = 0, k = 0; i < batch.size(); ++i)
+  {
+    EXPECT_EQ(fpaths[i], batch.fpath(i));
+
+    if (100 == i || batch.size() - 1 == i)
+    {
+      continue;
+    }
+
+    auto r = batch.get(i);
+    ASSERT_TRUE(r.has_value());
+    EXPECT_EQ(contents[k], r.value());
+    EXPECT_EQ(contents[k], batch.at(i));
+    total += contents[k].size();
+    ++k;
+  }
+  EXPECT_EQ(total, batch.arena_size());
+
+  auto missing = batch.get(100);
+  ASSERT_FALSE(missing.has_value());
+  EXPECT_EQ(ywen::file_op::open, missing.error().op());
+  EXPECT_EQ(ENOENT, missing.error().err_no());
+  EXPECT_STREQ(fpaths[100].c_str(), missing.error().fpath());
+  EXPECT_THROW(batch.at(100), ywen::file_open_error);
+
+  auto dir = batch.get(batch.size() - 1);
+  ASSERT_FALSE(dir.has_value());
+  EXPECT_EQ(EISDIR, dir.error().err_no());
+  EXPECT_THROW(batch.at(batch.size() - 1), ywen::file_read_error);
+
+  // Reloading picks up the changes.
+  {
+    file f(fpaths[0]);
+    f.open_write();
+    f.write("changed", 7);
+  }
+  batch.read_all(pool);
+  EXPECT_EQ("changed", batch.at(0));
+  EXPECT_EQ(total + 7, batch.arena_size());
+}
+
+TEST(TestFile, test_file_reader)
+{
+  const std::string fpath = temp_path("reader");
+  std::string data(100000 + 17, '\0');
+  for (size_t i = 0; i < data.size(); ++i)
+  {
+    data[i] = static_cast<char>(i * 131 + i / 7);
+  }
+
+  {
+    file f(fpath);
+    f.open_write();
+    f.write(data.data(), data.size());
+  }
+
+  file f(fpath);
+  f.open_read();
+
+  for (size_t buffer_count : {1, 2, 8})
+  {
+    for (size_t buffer_size : {1U, 4096U, 1U << 20})
+    {
+      const off_t offset = 3;
+      ywen::file_reader reader(f, buffer_count, buffer_size, offset);
+
+      std::string read;
+      for (std::string_view chunk = reader.next(); !chunk.empty();
+           chunk = reader.next())
+      {
+        EXPECT_LE(chunk.size(), buffer_size);
+        read.append(chunk.data(), chunk.size());
+      }
+      EXPECT_EQ(data.substr(offset), read);
+
+      // The end of the file is sticky.
+      EXPECT_TRUE(reader.next().empty());
+    }
+  }
+
+  // Stop before the end of the file.
+  {
+    ywen::file_reader reader(f, 2, 1024);
+    EXPECT_EQ(data.substr(0, 1024), reader.next());
+  }
+
+  // The position of `f` is not used.
+  char buf[4] = {};
+  EXPECT_EQ(4U, f.read(buf, 4));
+  EXPECT_EQ(0, std::memcmp(buf, data.data(), 4));
+}
+
+TEST(TestFile, test_file_reader_error)
+{
+  // A directory can be opened for reading, but reading it fails.
+  file f(testing::TempDir());
+  f.open_read();
+
+  ywen::file_reader reader(f, 2, 4096);
+  for (int i = 0; i < 2; ++i)
+  {
+    try
+    {
+      reader.next();
+      FAIL() << "file_read_error is not thrown";
+    }
+    catch (ywen::file_read_error const & e)
+    {
+      EXPECT_EQ(EISDIR, e.err_no());
+      EXPECT_STREQ(testing::TempDir().c_str(), e.fpath());
+    }
+  }
+}
+
+TEST(TestFile, test_crc32c)
+{
+  // The check value of CRC-32C.
+  EXPECT_EQ(0xe3069283U, ywen::crc32c("123456789", 9));
+  EXPECT_EQ(0U, ywen::crc32c("", 0));
+
+  // The CRC can be computed in pieces, at any alignment.
+  std::string data(1000, '\0');
+  for (size_t i = 0; i < data.size(); ++i)
+  {
+    data[i] = static_cast<char>(i * 7);
+  }
+  const uint32_t whole = ywen::crc32c(data.data(), data.size());
+  for (size_t split : {1, 3, 8, 13, 500, 999})
+  {
+    EXPECT_EQ(
+      whole,
+      ywen::crc32c(
+        data.data() + split,
+        data.size() - split,
+        ywen::crc32c(data.data(), split)));
+  }
+}
+
+namespace
+{
+
+struct record
+{
+  uint32_t id;
+  uint16_t kind;
+  char name[10];
+};
+
+/// Fill `v` with `count` records.
+void
+make_records(ywen::vector<record> & v, size_t count)
+{
+  v.resize(count);
+  for (size_t i = 0; i < count; ++i)
+  {
+    v[i] = record{static_cast<uint32_t>(i), static_cast<uint16_t>(i % 3), {}};
+    std::snprintf(
+      v[i].name,
+      sizeof(v[i].name),
+      "r%u",
+      static_cast<unsigned>(i % 100000000));
+  }
+}
+
+void
+expect_records(ywen::vector<record> const & v, size_t count)
+{
+  ASSERT_EQ(count, v.size());
+  for (size_t i = 0; i < count; ++i)
+  {
+    EXPECT_EQ(i, v[i].id);
+    EXPECT_EQ(i % 3, v[i].kind);
+  }
+}
+
+}  // namespace
+
+TEST(TestFile, test_vector_io)
+{
+  const std::string fpath = temp_path("vector_io");
+  ywen::thread_pool pool(2);
+
+  // Empty, shorter than a block, an exact number of blocks, and with a
+  // short last block.
+  for (size_t count : {0, 5, 64, 1001})
+  {
+    for (size_t block_size : {1U, 64U, 100U, 1U << 20})
+    {
+      ywen::vector<record> v;
+      make_records(v, count);
+
+      {
+        file f(fpath);
+        f.open_write();
+        ywen::write_vector(f, v, block_size);
+      }
+
+      file f(fpath);
+      f.open_read();
+
+      ywen::vector<record> w;
+      ywen::read_vector(f, w, &pool);
+      expect_records(w, count);
+
+      ywen::vector<record> u = {record{}};
+      ywen::read_vector(f, u);
+      expect_records(u, count);
+    }
+  }
+}
+
+TEST(TestFile, test_vector_io_streaming)
+{
+  const std::string fpath = temp_path("vector_io_streaming");
+  const size_t COUNT = 1000;
+  ywen::vector<record> v;
+  make_records(v, COUNT);
+
+  // Append and read in pieces that don't line up with the blocks.
+  {
+    file f(fpath);
+    f.open_write();
+    ywen::block_writer writer(f, sizeof(record), 100);
+    for (size_t i = 0; i < COUNT;)
+    {
+      const size_t n = std::min<size_t>(i % 13 + 1, COUNT - i);
+      writer.append(v.data() + i, n);
+      i += n;
+    }
+    writer.finish();
+  }
+
+  file f(fpath);
+  f.open_read();
+  ywen::block_reader reader(f);
+  EXPECT_EQ(sizeof(record), reader.element_size());
+  EXPECT_EQ(COUNT, reader.element_count());
+  EXPECT_EQ(100U, reader.block_size());
+
+  ywen::vector<record> w;
+  w.resize(COUNT);
+  for (size_t i = 0; i < COUNT;)
+  {
+    const size_t n = reader.read(w.data() + i, i % 17 + 1);
+    ASSERT_GT(n, 0U);
+    i += n;
+  }
+  EXPECT_EQ(0U, reader.read(w.data(), 1));
+  expect_records(w, COUNT);
+}
+
+TEST(TestFile, test_vector_io_corrupt)
+{
+  const std::string fpath = temp_path("vector_io_corrupt");
+  const size_t BLOCK_SIZE = 64;
+  const size_t BLOCK_COUNT = 10;
+  ywen::vector<record> v;
+  make_records(v, BLOCK_SIZE * BLOCK_COUNT / sizeof(record));
+
+  auto write = [&]() {
+    file f(fpath);
+    f.open_write();
+    ywen::write_vector(f, v, BLOCK_SIZE);
+  };
+
+  // The offset of block `b`, after the 32-byte header.
+  auto block_offset = [&](size_t b) {
+    return static_cast<off_t>(32 + b * (8 + BLOCK_SIZE));
+  };
+
+  auto expect_corrupt = [&](size_t block, ywen::thread_pool * pool) {
+    file f(fpath);
+    f.open_read();
+    ywen::vector<record> w;
+    make_records(w, 3);
+    try
+    {
+      ywen::read_vector(f, w, pool);
+      FAIL() << "file_corrupt_error is not thrown";
+    }
+    catch (ywen::file_corrupt_error const & e)
+    {
+      EXPECT_EQ(block, e.block());
+      EXPECT_EQ(EBADMSG, e.err_no());
+      EXPECT_STREQ(fpath.c_str(), e.fpath());
+    }
+
+    // Strong guarantee: `w` is not changed.
+    expect_records(w, 3);
+  };
+
+  ywen::thread_pool pool(3);
+
+  // Flip a payload byte of blocks 7 and 2: the first one is reported.
+  write();
+  {
+    file f(fpath);
+    f.open_read();
+    char c[2];
+    f.pread(&c[0], 1, block_offset(7) + 20);
+    f.pread(&c[1], 1, block_offset(2) + 8);
+    f.close();
+
+    c[0] ^= 1;
+    c[1] ^= 0x40;
+    std::FILE * fp = std::fopen(fpath.c_str(), "r+");
+    ASSERT_NE(nullptr, fp);
+    std::fseek(fp, block_offset(7) + 20, SEEK_SET);
+    std::fputc(c[0], fp);
+    std::fseek(fp, block_offset(2) + 8, SEEK_SET);
+    std::fputc(c[1], fp);
+    std::fclose(fp);
+  }
+  expect_corrupt(2, nullptr);
+  expect_corrupt(2, &pool);
+
+  // A truncated file.
+  write();
+  ASSERT_EQ(0, ::truncate(fpath.c_str(), block_offset(5) + 3));
+  expect_corrupt(5, &pool);
+
+  // The header.
+  write();
+  ASSERT_EQ(0, ::truncate(fpath.c_str(), 31));
+  expect_corrupt(ywen::file_corrupt_error::HEADER, nullptr);
+
+  // The element type doesn't match.
+  write();
+  {
+    file f(fpath);
+    f.open_read();
+    ywen::vector<uint32_t> w;
+    EXPECT_THROW(ywen::read_vector(f, w), ywen::file_corrupt_error);
+  }
+
+  ywen::file_corrupt_error e("/tmp/v", 3);
+  EXPECT_STREQ("corrupt block 3 of '/tmp/v': Bad message (errno 74)", e.what());
+}
+
+namespace
+{
+
+/// Return `size` bytes of text-like data that compresses well.
+std::string
+make_text(size_t size, unsigned seed)
+{
+  static char const * const WORDS[] = {
+    "alpha ", "beta ", "gamma ", "delta ", "file ", "vector ", "\n", "42 "};
+
+  std::mt19937 rng(seed);
+  std::string text;
+  while (text.size() < size)
+  {
+    text += WORDS[rng() % 8];
+  }
+  text.resize(size);
+  return text;
+}
+
+}  // namespace
+
+TEST(TestFile, test_codec)
+{
+  std::mt19937 rng(1);
+  std::string random(100000, '\0');
+  for (char & c : random)
+  {
+    c = static_cast<char>(rng());
+  }
+
+  std::vector<std::string> inputs = {
+    "",
+    "a",
+    "abcd",
+    "0123456789012",
+    std::string(100000, 'z'),
+    make_text(100000, 2),
+    random,
+  };
+  for (size_t size = 0; size < 40; ++size)
+  {
+    inputs.push_back(make_text(size, 3));
+  }
+
+  ywen::lz_codec lz;
+  ywen::null_codec null;
+  for (ywen::codec const * c : {static_cast<ywen::codec const *>(&lz),
+                                static_cast<ywen::codec const *>(&null)})
+  {
+    for (std::string const & input : inputs)
+    {
+      std::string compressed(c->max_compressed_size(input.size()), '\0');
+      compressed.resize(
+        c->compress(input.data(), input.size(), &compressed[0]));
+
+      std::string output(input.size(), '\0');
+      ASSERT_TRUE(c->decompress(
+        compressed.data(), compressed.size(), &output[0], output.size()));
+      EXPECT_EQ(input, output);
+
+      // The wrong size is detected.
+      std::string longer(input.size() + 1, '\0');
+      EXPECT_FALSE(c->decompress(
+        compressed.data(), compressed.size(), &longer[0], longer.size()));
+    }
+  }
+
+  // The text and the runs compress; the random data doesn't grow much.
+  std::string buf(lz.max_compressed_size(100000), '\0');
+  EXPECT_LT(lz.compress(inputs[4].data(), 100000, &buf[0]), 1000U);
+  EXPECT_LT(lz.compress(inputs[5].data(), 100000, &buf[0]), 50000U);
+  EXPECT_LE(lz.compress(random.data(), 100000, &buf[0]), 100000U + 400U);
+
+  // Malformed data is rejected without reading or writing out of bounds
+  // (which the sanitizers would catch).
+  std::string compressed(lz.max_compressed_size(1000), '\0');
+  compressed.resize(lz.compress(inputs[5].data(), 1000, &compressed[0]));
+  std::string output(1000, '\0');
+  for (int i = 0; i < 2000; ++i)
+  {
+    std::string bad = compressed;
+    bad[rng() % bad.size()] = static_cast<char>(rng());
+    bad.resize(bad.size() - rng() % 3);
+    lz.decompress(bad.data(), bad.size(), &output[0], output.size());
+  }
+}
+
+TEST(TestFile, test_compressed_file)
+{
+  const std::string fpath = temp_path("compressed");
+  const std::string text = make_text(1000003, 4);
+  ywen::lz_codec lz;
+  ywen::thread_pool pool(3);
+
+  for (ywen::thread_pool * p :
+       {static_cast<ywen::thread_pool *>(nullptr), &pool})
+  {
+    {
+      file f(fpath);
+      f.open_write();
+      ywen::compressed_writer writer(f, lz, 10000, p);
+      for (size_t i = 0; i < text.size();)
+      {
+        const size_t n = std::min<size_t>(i % 7777 + 1, text.size() - i);
+        writer.write(text.data() + i, n);
+        i += n;
+      }
+      writer.finish();
+
+      // It does compress.
+      EXPECT_LT(f.size(), text.size() / 2);
+    }
+
+    file f(fpath);
+    f.open_read();
+    ywen::compressed_reader reader(f, lz);
+    EXPECT_EQ(text.size(), reader.size());
+    EXPECT_EQ(10000U, reader.block_size());
+    EXPECT_EQ(101U, reader.block_count());
+
+    std::string all(text.size(), '\0');
+    EXPECT_EQ(text.size(), reader.pread(&all[0], all.size(), 0, p));
+    EXPECT_EQ(text, all);
+
+    // Random access, across blocks and at the end.
+    std::mt19937 rng(5);
+    for (int i = 0; i < 100; ++i)
+    {
+      const size_t offset = rng() % (text.size() + 10);
+      const size_t count = rng() % 30000;
+      std::string part(count, '\0');
+      const size_t n = reader.pread(&part[0], count, offset, p);
+      part.resize(n);
+      EXPECT_EQ(offset < text.size() ? text.substr(offset, count) : "", part);
+    }
+  }
+
+  // An empty file.
+  {
+    file f(fpath);
+    f.open_write();
+    ywen::compressed_writer writer(f, lz);
+    writer.finish();
+  }
+  {
+    file f(fpath);
+    f.open_read();
+    ywen::compressed_reader reader(f, lz);
+    EXPECT_EQ(0U, reader.size());
+    char c;
+    EXPECT_EQ(0U, reader.pread(&c, 1, 0));
+  }
+}
+
+TEST(TestFile, test_compressed_file_corrupt)
+{
+  const std::string fpath = temp_path("compressed_corrupt");
+  const std::string text = make_text(100000, 6);
+  ywen::lz_codec lz;
+
+  {
+    file f(fpath);
+    f.open_write();
+    ywen::compressed_writer writer(f, lz, 10000);
+    writer.write(text.data(), text.size());
+    writer.finish();
+  }
+
+  // Another codec.
+  {
+    file f(fpath);
+    f.open_read();
+    ywen::null_codec null;
+    EXPECT_THROW(ywen::compressed_reader(f, null), ywen::file_corrupt_error);
+  }
+
+  // Flip a byte in block 3 (the blocks come first, in order).
+  uint64_t offset = 0;
+  {
+    file f(fpath);
+    f.open_read();
+    ywen::compressed_reader reader(f, lz);
+
+    // Find the offset of block 3 by its compressed size: read the index
+    // entries that precede the footer.
+    const size_t file_size = f.size();
+    std::vector<ywen::compressed_block_entry> index(reader.block_count());
+    f.pread(
+      index.data(),
+      index.size() * sizeof(index[0]),
+      static_cast<off_t>(file_size - 40 - index.size() * sizeof(index[0])));
+    offset = index[3].offset + index[3].compressed_size / 2;
+  }
+  {
+    std::FILE * fp = std::fopen(fpath.c_str(), "r+");
+    ASSERT_NE(nullptr, fp);
+    std::fseek(fp, static_cast<long>(offset), SEEK_SET);
+    const int c = std::fgetc(fp);
+    std::fseek(fp, static_cast<long>(offset), SEEK_SET);
+    std::fputc(c ^ 0x10, fp);
+    std::fclose(fp);
+  }
+
+  file f(fpath);
+  f.open_read();
+  ywen::compressed_reader reader(f, lz);
+
+  // The other blocks are still readable.
+  std::string part(30000, '\0');
+  EXPECT_EQ(30000U, reader.pread(&part[0], part.size(), 0));
+  EXPECT_EQ(text.substr(0, 30000), part);
+
+  try
+  {
+    reader.pread(&part[0], 100, 35000);
+    FAIL() << "file_corrupt_error is not thrown";
+  }
+  catch (ywen::file_corrupt_error const & e)
+  {
+    EXPECT_EQ(3U, e.block());
+  }
+
+  // The footer.
+  ASSERT_EQ(0, ::truncate(fpath.c_str(), static_cast<off_t>(f.size() - 1)));
+  try
+  {
+    ywen::compressed_reader r(f, lz);
+    FAIL() << "file_corrupt_error is not thrown";
+  }
+  catch (ywen::file_corrupt_error const & e)
+  {
+    EXPECT_EQ(ywen::file_corrupt_error::HEADER, e.block());
+  }
+}
@@ -0,0 +1,236 @@
+#pragma once
+
+#include <cassert>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace ywen
+{
+
+/// A simple `std::expected`-like type (which is only available since C++23)
+/// that holds either a value of type `_Ty` or an error of type `_Err`.
+///
+/// It is used to report errors that are expected to happen often (e.g.,
+/// "file not found" when probing directories), where throwing an exception
+/// would be too costly. The caller must check `has_value()` before calling
+/// `value()` or `error()`, just like the bounds of `vector::at` must be
+/// checked: accessing the wrong one is a programming bug and is `assert`ed.
+///
+/// `_Ty` and `_Err` must not throw when they are moved or destroyed.
+///
+/// A result is not assignable: it's meant to be returned and checked, not
+/// kept and reused. Assigning an error over a value (or vice versa) would
+/// destroy one member and construct the other, which can't give the strong
+/// exception guarantee if the construction throws, so the assignment
+/// operators are deleted rather than made to give a weaker guarantee.
+template<typename _Ty, typename _Err>
+class result
+{
+  static_assert(std::is_nothrow_move_constructible<_Ty>::value, "");
+  static_assert(std::is_nothrow_move_constructible<_Err>::value, "");
+
+public:
+  /// Construct a result that holds a value.
+  ///
+  /// Throws: exceptions thrown by _Ty's copy constructor.
+  result(_Ty const & value) : m_has_value(true)
+  {
+    ::new (static_cast<void *>(&m_value)) _Ty(value);
+  }
+
+  /// Construct a result that holds a value.
+  result(_Ty && value) noexcept : m_has_value(true)
+  {
+    ::new (static_cast<void *>(&m_value)) _Ty(std::move(value));
+  }
+
+  /// Construct a result that holds an error.
+  result(_Err const & error) noexcept(
+    std::is_nothrow_copy_constructible<_Err>::value)
+    : m_has_value(false)
+  {
+    ::new (static_cast<void *>(&m_error)) _Err(error);
+  }
+
+  /// Throws: exceptions thrown by _Ty's or _Err's copy constructor.
+  result(result const & other) : m_has_value(other.m_has_value)
+  {
+    if (m_has_value)
+    {
+      ::new (static_cast<void *>(&m_value)) _Ty(other.m_value);
+    }
+    else
+    {
+      ::new (static_cast<void *>(&m_error)) _Err(other.m_error);
+    }
+  }
+
+  result(result && other) noexcept : m_has_value(other.m_has_value)
+  {
+    if (m_has_value)
+    {
+      ::new (static_cast<void *>(&m_value)) _Ty(std::move(other.m_value));
+    }
+    else
+    {
+      ::new (static_cast<void *>(&m_error)) _Err(std::move(other.m_error));
+    }
+  }
+
+  result &
+  operator=(result const &) = delete;
+
+  result &
+  operator=(result &&) = delete;
+
+  ~result() noexcept
+  {
+    if (m_has_value)
+    {
+      m_value.~_Ty();
+    }
+    else
+    {
+      m_error.~_Err();
+    }
+  }
+
+  /// Check if the result holds a value.
+  bool
+  has_value() const noexcept
+  {
+    return m_has_value;
+  }
+
+  /// Check if the result holds a value.
+  explicit operator bool() const noexcept
+  {
+    return m_has_value;
+  }
+
+  /// Return the value. The result must hold a value.
+  _Ty &
+  value() & noexcept
+  {
+    assert((m_has_value));
+    return m_value;
+  }
+
+  /// Return the value. The result must hold a value.
+  _Ty const &
+  value() const & noexcept
+  {
+    assert((m_has_value));
+    return m_value;
+  }
+
+  /// Return the value. The result must hold a value.
+  _Ty &&
+  value() && noexcept
+  {
+    assert((m_has_value));
+    return std::move(m_value);
+  }
+
+  /// Return the error. The result must hold an error.
+  _Err const &
+  error() const noexcept
+  {
+    assert((!m_has_value));
+    return m_error;
+  }
+
+private:
+  bool m_has_value;
+
+  union
+  {
+    _Ty m_value;
+    _Err m_error;
+  };
+};
+
+/// The specialization for the operations that return nothing on success.
+template<typename _Err>
+class result<void, _Err>
+{
+  static_assert(std::is_nothrow_move_constructible<_Err>::value, "");
+
+public:
+  /// Construct a successful result.
+  result() noexcept : m_has_value(true)
+  {
+    // Empty
+  }
+
+  /// Construct a result that holds an error.
+  result(_Err const & error) noexcept(
+    std::is_nothrow_copy_constructible<_Err>::value)
+    : m_has_value(false)
+  {
+    ::new (static_cast<void *>(&m_error)) _Err(error);
+  }
+
+  /// Throws: exceptions thrown by _Err's copy constructor.
+  result(result const & other) : m_has_value(other.m_has_value)
+  {
+    if (!m_has_value)
+    {
+      ::new (static_cast<void *>(&m_error)) _Err(other.m_error);
+    }
+  }
+
+  result(result && other) noexcept : m_has_value(other.m_has_value)
+  {
+    if (!m_has_value)
+    {
+      ::new (static_cast<void *>(&m_error)) _Err(std::move(other.m_error));
+    }
+  }
+
+  result &
+  operator=(result const &) = delete;
+
+  result &
+  operator=(result &&) = delete;
+
+  ~result() noexcept
+  {
+    if (!m_has_value)
+    {
+      m_error.~_Err();
+    }
+  }
+
+  /// Check if the result is successful.
+  bool
+  has_value() const noexcept
+  {
+    return m_has_value;
+  }
+
+  /// Check if the result is successful.
+  explicit operator bool() const noexcept
+  {
+    return m_has_value;
+  }
+
+  /// Return the error. The result must hold an error.
+  _Err const &
+  error() const noexcept
+  {
+    assert((!m_has_value));
+    return m_error;
+  }
+
+private:
+  bool m_has_value;
+
+  union
+  {
+    _Err m_error;
+  };
+};
+
+}  // namespace ywen
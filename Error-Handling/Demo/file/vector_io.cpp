@@ -0,0 +1,392 @@
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+
+#include <sys/uio.h>
+
+#include "crc32c.hpp"
+#include "vector_io.hpp"
+
+namespace ywen
+{
+
+namespace
+{
+
+struct header
+{
+  char magic[8];
+  uint32_t element_size;
+  uint32_t block_size;
+  uint64_t element_count;
+  uint32_t reserved;
+
+  /// The CRC-32C of the bytes above.
+  uint32_t crc;
+};
+
+static_assert(sizeof(header) == 32, "");
+
+struct block_header
+{
+  /// The CRC-32C of the payload.
+  uint32_t crc;
+  uint32_t size;
+};
+
+static_assert(sizeof(block_header) == 8, "");
+
+constexpr char MAGIC[8] = {'Y', 'W', 'V', 'E', 'C', 'B', 'L', '1'};
+
+/// The number of blocks written or read by one `pwritev`/`preadv`, which
+/// takes two buffers per block. It is far below `IOV_MAX` (1024 on Linux).
+constexpr size_t BATCH = 64;
+
+/// The payload bytes a thread checks at least per task.
+constexpr size_t CHECK_GRAIN_BYTES = 1U << 20;
+
+uint32_t
+header_crc(header const & h) noexcept
+{
+  return crc32c(&h, offsetof(header, crc));
+}
+
+/// Lower `target` to `value` if `value` is smaller.
+void
+store_min(std::atomic<uint64_t> & target, uint64_t value) noexcept
+{
+  uint64_t current = target.load(std::memory_order_relaxed);
+  while (value < current &&
+         !target.compare_exchange_weak(
+           current, value, std::memory_order_relaxed))
+  {
+    // `current` is reloaded by `compare_exchange_weak`.
+  }
+}
+
+}  // namespace
+
+block_writer::block_writer(
+  file & f,
+  size_t element_size,
+  size_t block_size)
+  : m_file(f),
+    m_element_size(element_size),
+    m_block_size(block_size),
+    m_total(0),
+    m_offset(sizeof(header)),
+    m_staging(new char[block_size]),
+    m_staged(0),
+    m_finished(false)
+{
+  assert((element_size > 0));
+  assert((element_size <= std::numeric_limits<uint32_t>::max()));
+  assert((block_size > 0));
+  assert((block_size <= std::numeric_limits<uint32_t>::max()));
+}
+
+void
+block_writer::append(void const * data, size_t count)
+{
+  assert((!m_finished));
+
+  if (0 == count)
+  {
+    // `data` may be `nullptr` (e.g., of an empty vector).
+    return;
+  }
+
+  char const * p = static_cast<char const *>(data);
+  size_t bytes = count * m_element_size;
+
+  // Complete the staged block first.
+  if (m_staged > 0)
+  {
+    const size_t n = std::min(m_block_size - m_staged, bytes);
+    std::memcpy(m_staging.get() + m_staged, p, n);
+    m_staged += n;
+    p += n;
+    bytes -= n;
+
+    if (m_staged < m_block_size)
+    {
+      m_total += count * m_element_size;
+      return;
+    }
+
+    this->_write_block(m_staging.get(), m_block_size);
+    m_staged = 0;
+  }
+
+  const size_t whole = bytes / m_block_size;
+  this->_write_blocks(p, whole);
+  p += whole * m_block_size;
+  bytes -= whole * m_block_size;
+
+  std::memcpy(m_staging.get(), p, bytes);
+  m_staged = bytes;
+
+  m_total += count * m_element_size;
+}
+
+void
+block_writer::finish()
+{
+  assert((!m_finished));
+
+  if (m_staged > 0)
+  {
+    this->_write_block(m_staging.get(), m_staged);
+    m_staged = 0;
+  }
+
+  header h = {};
+  std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+  h.element_size = static_cast<uint32_t>(m_element_size);
+  h.block_size = static_cast<uint32_t>(m_block_size);
+  h.element_count = m_total / m_element_size;
+  h.crc = header_crc(h);
+
+  m_file.pwrite(&h, sizeof(h), 0);
+
+  m_finished = true;
+}
+
+void
+block_writer::_write_blocks(char const * data, size_t count)
+{
+  block_header headers[BATCH];
+  struct iovec iov[BATCH * 2];
+
+  while (count > 0)
+  {
+    const size_t n = std::min(count, BATCH);
+    for (size_t i = 0; i < n; ++i)
+    {
+      char const * payload = data + i * m_block_size;
+      headers[i].crc = crc32c(payload, m_block_size);
+      headers[i].size = static_cast<uint32_t>(m_block_size);
+
+      iov[i * 2] = {&headers[i], sizeof(block_header)};
+      iov[i * 2 + 1] = {const_cast<char *>(payload), m_block_size};
+    }
+
+    m_file.pwrite_vectored(iov, n * 2, m_offset);
+
+    m_offset += static_cast<off_t>(n * (sizeof(block_header) + m_block_size));
+    data += n * m_block_size;
+    count -= n;
+  }
+}
+
+void
+block_writer::_write_block(char const * data, size_t size)
+{
+  block_header h = {crc32c(data, size), static_cast<uint32_t>(size)};
+  struct iovec iov[2] = {
+    {&h, sizeof(h)},
+    {const_cast<char *>(data), size},
+  };
+
+  m_file.pwrite_vectored(iov, 2, m_offset);
+
+  m_offset += static_cast<off_t>(sizeof(h) + size);
+}
+
+block_reader::block_reader(file const & f)
+  : m_file(f),
+    m_element_size(0),
+    m_element_count(0),
+    m_block_size(0),
+    m_total(0),
+    m_position(0),
+    m_staged_begin(0),
+    m_staged_size(0)
+{
+  header h;
+  if (m_file.pread(&h, sizeof(h), 0) != sizeof(h) ||
+      std::memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+      h.crc != header_crc(h) || 0 == h.element_size || 0 == h.block_size ||
+      h.element_count > std::numeric_limits<uint64_t>::max() / h.element_size)
+  {
+    throw file_corrupt_error(
+      m_file.fpath().c_str(), file_corrupt_error::HEADER);
+  }
+
+  m_element_size = h.element_size;
+  m_element_count = h.element_count;
+  m_block_size = h.block_size;
+  m_total = h.element_count * h.element_size;
+}
+
+size_t
+block_reader::element_size() const noexcept
+{
+  return m_element_size;
+}
+
+size_t
+block_reader::element_count() const noexcept
+{
+  return static_cast<size_t>(m_element_count);
+}
+
+size_t
+block_reader::block_size() const noexcept
+{
+  return m_block_size;
+}
+
+size_t
+block_reader::read(void * data, size_t count, thread_pool * pool)
+{
+  const uint64_t left = (m_total - m_position) / m_element_size;
+  count = static_cast<size_t>(std::min<uint64_t>(count, left));
+
+  char * p = static_cast<char *>(data);
+  size_t bytes = count * m_element_size;
+
+  // The rest of the staged block.
+  if (m_staged_begin < m_staged_size)
+  {
+    const size_t n = std::min(m_staged_size - m_staged_begin, bytes);
+    std::memcpy(p, m_staging.get() + m_staged_begin, n);
+    m_staged_begin += n;
+    p += n;
+    bytes -= n;
+    m_position += n;
+  }
+
+  if (0 == bytes)
+  {
+    return count;
+  }
+
+  // Now `m_position` is at the beginning of a block. Read the blocks that
+  // fit in `data` directly, including the last (short) block of the file.
+  const uint64_t b = m_position / m_block_size;
+  size_t whole = bytes / m_block_size;
+  size_t rest = bytes - whole * m_block_size;
+  if (rest > 0 && this->_payload_size(b + whole) == rest)
+  {
+    ++whole;
+    rest = 0;
+  }
+
+  this->_read_blocks(p, b, whole, pool);
+  p += bytes - rest;
+  m_position += bytes - rest;
+
+  // Stage the block that only fits partially.
+  if (rest > 0)
+  {
+    if (!m_staging)
+    {
+      m_staging.reset(new char[m_block_size]);
+    }
+
+    const size_t size = this->_payload_size(b + whole);
+    this->_read_blocks(m_staging.get(), b + whole, 1, nullptr);
+    std::memcpy(p, m_staging.get(), rest);
+    m_staged_begin = rest;
+    m_staged_size = size;
+    m_position += rest;
+  }
+
+  return count;
+}
+
+size_t
+block_reader::_payload_size(uint64_t b) const noexcept
+{
+  return static_cast<size_t>(
+    std::min<uint64_t>(m_block_size, m_total - b * m_block_size));
+}
+
+off_t
+block_reader::_offset(uint64_t b) const noexcept
+{
+  return static_cast<off_t>(
+    sizeof(header) + b * (sizeof(block_header) + m_block_size));
+}
+
+void
+block_reader::_read_blocks(
+  char * data,
+  uint64_t first,
+  size_t count,
+  thread_pool * pool)
+{
+  if (0 == count)
+  {
+    return;
+  }
+
+  // `data` gets the payloads back to back, without the block headers, which
+  // are read into `headers`.
+  std::unique_ptr<block_header[]> headers(new block_header[count]);
+
+  // The number of blocks that are read completely; the blocks after them
+  // are cut short by the end of the file.
+  size_t complete = 0;
+  while (complete < count)
+  {
+    const size_t n = std::min(count - complete, BATCH);
+    struct iovec iov[BATCH * 2];
+    size_t expected = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+      const size_t size = this->_payload_size(first + complete + i);
+      iov[i * 2] = {&headers[complete + i], sizeof(block_header)};
+      iov[i * 2 + 1] = {data + (complete + i) * m_block_size, size};
+      expected += sizeof(block_header) + size;
+    }
+
+    const size_t got =
+      m_file.pread_vectored(iov, n * 2, this->_offset(first + complete));
+    if (got < expected)
+    {
+      complete += (got / (sizeof(block_header) + m_block_size));
+      break;
+    }
+
+    complete += n;
+  }
+
+  // Check the payloads of the complete blocks.
+  std::atomic<uint64_t> first_corrupt(count);
+  auto check = [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i)
+    {
+      const size_t size = this->_payload_size(first + i);
+      if (headers[i].size != size ||
+          headers[i].crc != crc32c(data + i * m_block_size, size))
+      {
+        store_min(first_corrupt, i);
+        return;
+      }
+    }
+  };
+
+  if (pool != nullptr)
+  {
+    const size_t grain = std::max<size_t>(1, CHECK_GRAIN_BYTES / m_block_size);
+    pool->parallel_for(0, complete, grain, check);
+  }
+  else
+  {
+    check(0, complete);
+  }
+
+  store_min(first_corrupt, complete);
+  if (first_corrupt.load() < count)
+  {
+    throw file_corrupt_error(
+      m_file.fpath().c_str(), static_cast<size_t>(first + first_corrupt));
+  }
+}
+
+}  // namespace ywen
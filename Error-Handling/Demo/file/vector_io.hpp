@@ -0,0 +1,247 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+#include <sys/types.h>
+
+#include "../thread_pool/thread_pool.hpp"
+#include "../vector/vector.hpp"
+#include "exception.hpp"
+#include "file.hpp"
+
+namespace ywen
+{
+
+// NOTE(ywen): The checksummed block format of the elements of a vector:
+//
+//   header   (32 bytes)
+//   block 0  (8-byte block header + `block_size` bytes of payload)
+//   block 1
+//   ...
+//   block N  (8-byte block header + the rest of the payload)
+//
+// The payload is the bytes of the elements in order, cut into blocks of
+// `block_size` bytes; the last block may be shorter. Every block header
+// holds the CRC-32C and the size of the block's payload, and the header
+// holds the element size, the element count, the block size and its own
+// CRC-32C. Because all the blocks but the last one have the same size, the
+// offset of every block is known from the header, so the blocks can be
+// read and checked independently (and in parallel).
+//
+// The integers are in the native byte order, so the files can't be moved
+// between machines of different byte orders; the header check fails if
+// they are.
+
+/// The default payload size of a block.
+constexpr size_t DEFAULT_BLOCK_SIZE = 1U << 20;
+
+/// Write elements to a file in the checksummed block format, appending them
+/// in as many pieces as needed. The whole blocks are written directly from
+/// the caller's memory with `pwritev`; only a block that is split between
+/// two `append` calls is staged in a buffer.
+///
+/// The header is written last, by `finish`, so a file whose writing does
+/// not finish fails the header check when it is read.
+class block_writer
+{
+public:
+  /// Start writing elements of `element_size` bytes to `f`, which must be
+  /// open for writing, from the beginning of the file. `block_size` must be
+  /// at least 1 and less than 4 GiB.
+  ///
+  /// Throws:
+  /// - `std::bad_alloc`: When out of memory.
+  block_writer(
+    file & f,
+    size_t element_size,
+    size_t block_size = DEFAULT_BLOCK_SIZE);
+
+  block_writer(block_writer const &) = delete;
+
+  block_writer &
+  operator=(block_writer const &) = delete;
+
+  /// Append the `count` elements at `data`.
+  ///
+  /// Throws:
+  /// - file_write_error:
+  void
+  append(void const * data, size_t count);
+
+  /// Write the last block and the header. No element can be appended after
+  /// it.
+  ///
+  /// Throws:
+  /// - file_write_error:
+  void
+  finish();
+
+private:
+  /// Write the `count` whole blocks at `data`.
+  void
+  _write_blocks(char const * data, size_t count);
+
+  /// Write a block of `size` bytes at `data`.
+  void
+  _write_block(char const * data, size_t size);
+
+private:
+  file & m_file;
+  const size_t m_element_size;
+  const size_t m_block_size;
+
+  /// The number of payload bytes appended so far.
+  uint64_t m_total;
+
+  /// The offset of the next block in the file.
+  off_t m_offset;
+
+  /// The beginning of a block that is split between `append` calls.
+  std::unique_ptr<char[]> m_staging;
+  size_t m_staged;
+
+  bool m_finished;
+};
+
+/// Read elements from a file in the checksummed block format, in as many
+/// pieces as needed. The whole blocks are read directly into the caller's
+/// memory with `preadv`, and their checksums are checked (in parallel, on a
+/// thread pool, if one is given) before they are returned; only a block
+/// that is split between two `read` calls is staged in a buffer.
+class block_reader
+{
+public:
+  /// Read and check the header of `f`, which must be open for reading.
+  /// `f` must outlive the reader.
+  ///
+  /// Throws:
+  /// - `std::bad_alloc`: When out of memory.
+  /// - file_read_error:
+  /// - file_corrupt_error: The header is corrupt or too short.
+  explicit block_reader(file const & f);
+
+  block_reader(block_reader const &) = delete;
+
+  block_reader &
+  operator=(block_reader const &) = delete;
+
+  size_t
+  element_size() const noexcept;
+
+  size_t
+  element_count() const noexcept;
+
+  size_t
+  block_size() const noexcept;
+
+  /// Read the next `count` elements into `data`, checking the blocks they
+  /// come from on `pool` if it's not `nullptr`. Returns the number of
+  /// elements read, which is less than `count` only at the end.
+  ///
+  /// If it throws, `data` may have been partially overwritten, and the
+  /// reader must not be used any more.
+  ///
+  /// Throws:
+  /// - `std::bad_alloc`: When out of memory.
+  /// - file_read_error:
+  /// - file_corrupt_error: `block()` is the first corrupt block among the
+  ///   blocks read, including a block that is cut short by the end of the
+  ///   file.
+  size_t
+  read(void * data, size_t count, thread_pool * pool = nullptr);
+
+private:
+  /// The payload size of block `b`.
+  size_t
+  _payload_size(uint64_t b) const noexcept;
+
+  /// The offset of block `b` in the file.
+  off_t
+  _offset(uint64_t b) const noexcept;
+
+  /// Read `count` whole blocks, starting at block `first`, into `data`, and
+  /// check them.
+  void
+  _read_blocks(
+    char * data,
+    uint64_t first,
+    size_t count,
+    thread_pool * pool);
+
+private:
+  file const & m_file;
+  size_t m_element_size;
+  uint64_t m_element_count;
+  size_t m_block_size;
+
+  /// The total payload size.
+  uint64_t m_total;
+
+  /// The number of payload bytes returned so far.
+  uint64_t m_position;
+
+  /// The block that is split between `read` calls, whose payload is
+  /// `m_staging[0, m_staged_size)`, of which the bytes before
+  /// `m_staged_begin` have been returned.
+  std::unique_ptr<char[]> m_staging;
+  size_t m_staged_begin;
+  size_t m_staged_size;
+};
+
+/// Write all the elements of `v` to `f` in the checksummed block format.
+///
+/// Throws:
+/// - `std::bad_alloc`: When out of memory.
+/// - file_write_error:
+template<typename _Ty, typename _Storage>
+void
+write_vector(
+  file & f,
+  vector<_Ty, _Storage> const & v,
+  size_t block_size = DEFAULT_BLOCK_SIZE)
+{
+  static_assert(std::is_trivially_copyable<_Ty>::value, "");
+
+  block_writer writer(f, sizeof(_Ty), block_size);
+  writer.append(v.data(), v.size());
+  writer.finish();
+}
+
+/// Replace the elements of `v` with the elements of `f` in the checksummed
+/// block format, checking the blocks on `pool` if it's not `nullptr`.
+///
+/// Strong exception guarantee: the elements are read into a new vector,
+/// which is swapped with `v` only when all of them have been read and
+/// checked, so if it throws, `v` is not changed.
+///
+/// Throws:
+/// - `std::bad_alloc`: When out of memory.
+/// - file_read_error:
+/// - file_corrupt_error: Including when the element size in the header is
+///   not `sizeof(_Ty)` (`block()` is `file_corrupt_error::HEADER`).
+template<typename _Ty, typename _Storage>
+void
+read_vector(
+  file const & f,
+  vector<_Ty, _Storage> & v,
+  thread_pool * pool = nullptr)
+{
+  static_assert(std::is_trivially_copyable<_Ty>::value, "");
+
+  block_reader reader(f);
+  if (reader.element_size() != sizeof(_Ty))
+  {
+    throw file_corrupt_error(f.fpath().c_str(), file_corrupt_error::HEADER);
+  }
+
+  vector<_Ty, _Storage> tmp;
+  tmp.resize(reader.element_count());
+  reader.read(tmp.data(), tmp.size(), pool);
+
+  v.swap(tmp);  // `swap()` doesn't throw.
+}
+
+}  // namespace ywen
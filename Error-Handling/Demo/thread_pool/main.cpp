@@ -0,0 +1,106 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+#include "thread_pool.hpp"
+
+using ywen::task_group;
+using ywen::thread_pool;
+
+namespace
+{
+
+/// Compute the `n`-th Fibonacci number with nested task groups.
+size_t
+fib(thread_pool & pool, size_t n)
+{
+  if (n < 2)
+  {
+    return n;
+  }
+
+  size_t a = 0;
+  task_group group(pool);
+  group.run([&pool, &a, n]() { a = fib(pool, n - 1); });
+  const size_t b = fib(pool, n - 2);
+  group.wait();
+
+  return a + b;
+}
+
+}  // namespace
+
+TEST(TestThreadPool, test_parallel_for)
+{
+  for (size_t threads : {0, 1, 4})
+  {
+    thread_pool pool(threads);
+    EXPECT_EQ(threads, pool.size());
+
+    for (size_t grain : {0, 1, 7, 1000, 5000})
+    {
+      std::vector<std::atomic<int>> visits(1000);
+      pool.parallel_for(0, visits.size(), grain, [&](size_t b, size_t e) {
+        EXPECT_LT(b, e);
+        EXPECT_LE(e - b, (0 == grain ? 1 : grain));
+        for (size_t i = b; i < e; ++i)
+        {
+          ++visits[i];
+        }
+      });
+
+      for (std::atomic<int> const & v : visits)
+      {
+        EXPECT_EQ(1, v.load());
+      }
+    }
+
+    // An empty range doesn't call the function.
+    pool.parallel_for(5, 5, 1, [](size_t, size_t) { FAIL(); });
+  }
+}
+
+TEST(TestThreadPool, test_nested)
+{
+  thread_pool pool(3);
+  EXPECT_EQ(6765U, fib(pool, 20));
+}
+
+TEST(TestThreadPool, test_exception)
+{
+  thread_pool pool(2);
+
+  std::atomic<size_t> calls(0);
+  try
+  {
+    pool.parallel_for(0, 100000, 1, [&calls](size_t b, size_t) {
+      ++calls;
+      if (10 == b)
+      {
+        throw std::runtime_error("10");
+      }
+    });
+    FAIL() << "The exception is not propagated";
+  }
+  catch (std::runtime_error const & e)
+  {
+    EXPECT_STREQ("10", e.what());
+  }
+
+  // The sub-ranges that have not started when the exception is thrown are
+  // skipped.
+  EXPECT_LT(calls.load(), 100000U);
+
+  // The group can be used again after `wait` rethrows.
+  task_group group(pool);
+  group.run([]() { throw std::logic_error("first"); });
+  EXPECT_THROW(group.wait(), std::logic_error);
+
+  std::atomic<int> runs(0);
+  group.run([&runs]() { ++runs; });
+  group.wait();
+  EXPECT_EQ(1, runs.load());
+}
@@ -0,0 +1,497 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace ywen
+{
+
+class task_group;
+
+/// A work-stealing thread pool.
+///
+/// Each worker thread has its own task queue. A task submitted by a worker
+/// (e.g., the second half of a range that the worker splits) goes to the back
+/// of the worker's own queue, and the worker takes tasks from the back, so it
+/// works on the most recent (i.e., the smallest and cache-hot) tasks first.
+/// An idle worker steals from the front of the other queues, where the
+/// oldest (i.e., the biggest) tasks are. Tasks submitted by the other
+/// threads go to a shared queue.
+///
+/// The tasks are run through `task_group`, which also reports their errors.
+/// A thread that waits for a `task_group` runs the pool's tasks while it
+/// waits, so a pool with 0 worker threads is valid: the waiting thread runs
+/// all the tasks.
+class thread_pool
+{
+public:
+  /// Start `thread_count` worker threads.
+  ///
+  /// Throws:
+  /// - `std::bad_alloc`: When out of memory.
+  /// - `std::system_error`: When a thread can't be started.
+  explicit thread_pool(size_t thread_count = default_thread_count());
+
+  thread_pool(thread_pool const &) = delete;
+
+  thread_pool &
+  operator=(thread_pool const &) = delete;
+
+  /// Stop and join the worker threads. All the `task_group`s must have been
+  /// waited for.
+  ~thread_pool() noexcept;
+
+  /// Return the number of worker threads.
+  size_t
+  size() const noexcept;
+
+  /// Call `fn(b, e)` for the sub-ranges `[b, e)` of `[begin, end)`, which
+  /// have at most `grain` (at least 1) elements each, in parallel. Returns
+  /// when all the calls have returned.
+  ///
+  /// If some calls throw, the sub-ranges that have not started are skipped,
+  /// and the first exception is rethrown after the running calls return.
+  ///
+  /// Throws:
+  /// - `std::bad_alloc`: When out of memory.
+  /// - Exceptions thrown by `fn`.
+  template<typename _Fn>
+  void
+  parallel_for(size_t begin, size_t end, size_t grain, _Fn const & fn);
+
+  /// Return the number of CPUs minus 1 (for the thread that waits), or 0 if
+  /// it's unknown.
+  static size_t
+  default_thread_count() noexcept;
+
+private:
+  friend class task_group;
+
+  struct _task_base
+  {
+    virtual ~_task_base() = default;
+
+    virtual void
+    run() noexcept = 0;
+  };
+
+  template<typename _Fn>
+  struct _task : _task_base
+  {
+    explicit _task(_Fn && fn) : m_fn(std::move(fn))
+    {
+      // Empty
+    }
+
+    void
+    run() noexcept override
+    {
+      m_fn();
+    }
+
+    _Fn m_fn;
+  };
+
+  struct _queue
+  {
+    std::mutex mutex;
+    std::deque<std::unique_ptr<_task_base>> tasks;
+  };
+
+  /// The thread pool and the queue index of the calling thread, if it is a
+  /// worker thread.
+  struct _worker_id
+  {
+    thread_pool const * pool;
+    size_t index;
+  };
+
+  static _worker_id &
+  _current() noexcept
+  {
+    thread_local _worker_id id = {nullptr, 0};
+    return id;
+  }
+
+  /// Submit `task`. `task` must not throw.
+  ///
+  /// Throws:
+  /// - `std::bad_alloc`: When out of memory.
+  template<typename _Fn>
+  void
+  _push(_Fn && task);
+
+  /// Take a task from the queues and run it. Returns false if there is no
+  /// task.
+  bool
+  _try_run_one() noexcept;
+
+  /// The loop of the worker thread `index`.
+  void
+  _work(size_t index) noexcept;
+
+  /// Stop and join the worker threads.
+  void
+  _stop() noexcept;
+
+  template<typename _Fn>
+  void
+  _split(
+    task_group & group,
+    size_t begin,
+    size_t end,
+    size_t grain,
+    _Fn const & fn);
+
+private:
+  /// The queues of the worker threads, followed by the shared queue.
+  std::vector<std::unique_ptr<_queue>> m_queues;
+
+  std::vector<std::thread> m_threads;
+
+  /// The number of tasks in all the queues.
+  std::atomic<size_t> m_pending;
+
+  /// The idle workers sleep on `m_sleep_cv` until a task is submitted.
+  std::mutex m_sleep_mutex;
+  std::condition_variable m_sleep_cv;
+  bool m_stop;
+};
+
+/// A group of tasks that run on a `thread_pool` and are waited for together.
+///
+/// When a task throws, the group is cancelled: the tasks that have not
+/// started are skipped, and `wait()` rethrows the first exception.
+class task_group
+{
+public:
+  explicit task_group(thread_pool & pool) noexcept
+    : m_pool(pool), m_pending(0), m_cancelled(false)
+  {
+    // Empty
+  }
+
+  task_group(task_group const &) = delete;
+
+  task_group &
+  operator=(task_group const &) = delete;
+
+  /// Wait for the tasks that have been submitted. Their exceptions are
+  /// dropped; call `wait()` to get them.
+  ~task_group() noexcept
+  {
+    this->_wait_all();
+  }
+
+  /// Submit `fn` to be run on the thread pool.
+  ///
+  /// Throws:
+  /// - `std::bad_alloc`: When out of memory.
+  template<typename _Fn>
+  void
+  run(_Fn && fn)
+  {
+    m_pending.fetch_add(1, std::memory_order_relaxed);
+    try
+    {
+      m_pool._push(
+        [this, fn = std::forward<_Fn>(fn)]() mutable noexcept {
+          this->_run(fn);
+        });
+    }
+    catch (...)
+    {
+      m_pending.fetch_sub(1, std::memory_order_relaxed);
+      throw;
+    }
+  }
+
+  /// Wait for all the submitted tasks, running the pool's tasks in the
+  /// meantime. Rethrows the first exception thrown by the tasks, after which
+  /// the group can be used again.
+  ///
+  /// Throws: the first exception thrown by the tasks.
+  void
+  wait()
+  {
+    this->_wait_all();
+
+    if (m_exception)
+    {
+      std::exception_ptr e = std::move(m_exception);
+      m_exception = nullptr;
+      m_cancelled.store(false, std::memory_order_relaxed);
+      std::rethrow_exception(e);
+    }
+  }
+
+  /// Check if a task has thrown. A long task may check it to stop early.
+  bool
+  cancelled() const noexcept
+  {
+    return m_cancelled.load(std::memory_order_relaxed);
+  }
+
+private:
+  template<typename _Fn>
+  void
+  _run(_Fn & fn) noexcept
+  {
+    if (!this->cancelled())
+    {
+      try
+      {
+        fn();
+      }
+      catch (...)
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_exception)
+        {
+          m_exception = std::current_exception();
+        }
+        m_cancelled.store(true, std::memory_order_relaxed);
+      }
+    }
+
+    // `this` must not be used after this because the waiting thread may
+    // destroy the group right away.
+    m_pending.fetch_sub(1, std::memory_order_release);
+  }
+
+  void
+  _wait_all() noexcept
+  {
+    while (m_pending.load(std::memory_order_acquire) > 0)
+    {
+      if (!m_pool._try_run_one())
+      {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+private:
+  thread_pool & m_pool;
+  std::atomic<size_t> m_pending;
+  std::atomic<bool> m_cancelled;
+  std::mutex m_mutex;
+  std::exception_ptr m_exception;
+};
+
+inline thread_pool::thread_pool(size_t thread_count)
+  : m_pending(0), m_stop(false)
+{
+  for (size_t i = 0; i <= thread_count; ++i)
+  {
+    m_queues.emplace_back(new _queue());
+  }
+
+  try
+  {
+    for (size_t i = 0; i < thread_count; ++i)
+    {
+      m_threads.emplace_back(&thread_pool::_work, this, i);
+    }
+  }
+  catch (...)
+  {
+    // Stop the threads that have been started.
+    this->_stop();
+    throw;
+  }
+}
+
+inline thread_pool::~thread_pool() noexcept
+{
+  this->_stop();
+}
+
+inline void
+thread_pool::_stop() noexcept
+{
+  {
+    std::lock_guard<std::mutex> lock(m_sleep_mutex);
+    m_stop = true;
+  }
+  m_sleep_cv.notify_all();
+
+  for (std::thread & t : m_threads)
+  {
+    t.join();
+  }
+  m_threads.clear();
+}
+
+inline size_t
+thread_pool::size() const noexcept
+{
+  return m_threads.size();
+}
+
+inline size_t
+thread_pool::default_thread_count() noexcept
+{
+  const size_t n = std::thread::hardware_concurrency();
+  return (n > 0 ? n - 1 : 0);
+}
+
+template<typename _Fn>
+void
+thread_pool::_push(_Fn && task)
+{
+  // `new` may throw `std::bad_alloc`.
+  std::unique_ptr<_task_base> t(new _task<_Fn>(std::forward<_Fn>(task)));
+
+  _worker_id const & id = _current();
+  _queue & q = *m_queues[this == id.pool ? id.index : m_threads.size()];
+  // Count the task before it becomes visible, so a worker that pops it
+  // straight away can't take `m_pending` below zero.
+  m_pending.fetch_add(1, std::memory_order_release);
+  try
+  {
+    std::lock_guard<std::mutex> lock(q.mutex);
+    // `push_back` may throw `std::bad_alloc`, in which case `t` is freed.
+    q.tasks.push_back(std::move(t));
+  }
+  catch (...)
+  {
+    m_pending.fetch_sub(1, std::memory_order_relaxed);
+    throw;
+  }
+
+  // Lock the mutex so a worker can't miss the notification between checking
+  // `m_pending` and going to sleep.
+  {
+    std::lock_guard<std::mutex> lock(m_sleep_mutex);
+  }
+  m_sleep_cv.notify_one();
+}
+
+inline bool
+thread_pool::_try_run_one() noexcept
+{
+  _worker_id const & id = _current();
+  const size_t count = m_queues.size();
+  const size_t self = (this == id.pool ? id.index : count - 1);
+
+  std::unique_ptr<_task_base> task;
+
+  // Take the newest task of our own queue first, then steal the oldest task
+  // of the other queues, starting with the next one so the thieves spread
+  // out.
+  for (size_t i = 0; i < count && !task; ++i)
+  {
+    const size_t index = (self + i) % count;
+    _queue & q = *m_queues[index];
+
+    std::lock_guard<std::mutex> lock(q.mutex);
+    if (q.tasks.empty())
+    {
+      continue;
+    }
+
+    if (index == self && index != count - 1)
+    {
+      task = std::move(q.tasks.back());
+      q.tasks.pop_back();
+    }
+    else
+    {
+      task = std::move(q.tasks.front());
+      q.tasks.pop_front();
+    }
+  }
+
+  if (!task)
+  {
+    return false;
+  }
+
+  m_pending.fetch_sub(1, std::memory_order_relaxed);
+  task->run();
+  return true;
+}
+
+inline void
+thread_pool::_work(size_t index) noexcept
+{
+  _current() = _worker_id{this, index};
+
+  while (true)
+  {
+    if (this->_try_run_one())
+    {
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(m_sleep_mutex);
+    m_sleep_cv.wait(lock, [this]() {
+      return m_stop || m_pending.load(std::memory_order_acquire) > 0;
+    });
+
+    if (m_stop && 0 == m_pending.load(std::memory_order_acquire))
+    {
+      return;
+    }
+  }
+}
+
+template<typename _Fn>
+void
+thread_pool::parallel_for(
+  size_t begin,
+  size_t end,
+  size_t grain,
+  _Fn const & fn)
+{
+  if (begin >= end)
+  {
+    return;
+  }
+
+  grain = (0 == grain ? 1 : grain);
+
+  task_group group(*this);
+  group.run([this, &group, begin, end, grain, &fn]() {
+    this->_split(group, begin, end, grain, fn);
+  });
+  group.wait();
+}
+
+template<typename _Fn>
+void
+thread_pool::_split(
+  task_group & group,
+  size_t begin,
+  size_t end,
+  size_t grain,
+  _Fn const & fn)
+{
+  // Keep the first half and submit the second half until the range is small
+  // enough, so the biggest halves are at the front of the queue for the
+  // thieves.
+  while (end - begin > grain)
+  {
+    const size_t mid = begin + (end - begin) / 2;
+    group.run([this, &group, mid, end, grain, &fn]() {
+      this->_split(group, mid, end, grain, fn);
+    });
+    end = mid;
+  }
+
+  if (!group.cancelled())
+  {
+    fn(begin, end);
+  }
+}
+
+}  // namespace ywen
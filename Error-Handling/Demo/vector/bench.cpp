@@ -0,0 +1,407 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+
+#include "../thread_pool/thread_pool.hpp"
+#include "huge_page_storage.hpp"
+#include "parallel_algorithm.hpp"
+#include "snapshot_vector.hpp"
+#include "vector.hpp"
+
+namespace
+{
+
+/// The number of elements of the benchmark vectors.
+constexpr size_t COUNT = 1U << 24;
+
+/// Fill `v` with `COUNT` pseudo-random numbers.
+void
+make_random(ywen::vector<uint64_t> & v)
+{
+  std::mt19937_64 rng(COUNT);
+
+  v.resize(COUNT);
+  for (size_t i = 0; i < COUNT; ++i)
+  {
+    v[i] = rng();
+  }
+}
+
+/// Sort `COUNT` random numbers.
+///
+/// Arguments:
+/// - 0: The number of worker threads; -1 runs `std::sort` on the calling
+///   thread without a thread pool, and 0 runs `parallel_sort` on the calling
+///   thread only.
+void
+BM_parallel_sort(benchmark::State & state)
+{
+  ywen::vector<uint64_t> original;
+  make_random(original);
+
+  ywen::thread_pool pool(
+    state.range(0) >= 0 ? static_cast<size_t>(state.range(0)) : 0);
+  ywen::vector<uint64_t> v;
+
+  for (auto _ : state)
+  {
+    state.PauseTiming();
+    v.resize(COUNT);
+    std::copy(original.data(), original.data() + COUNT, v.data());
+    state.ResumeTiming();
+
+    if (state.range(0) < 0)
+    {
+      std::sort(v.data(), v.data() + COUNT);
+    }
+    else
+    {
+      ywen::parallel_sort(pool, v);
+    }
+  }
+
+  state.SetItemsProcessed(
+    static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(COUNT));
+}
+
+/// Transform `COUNT` numbers with a cheap hash.
+///
+/// Arguments:
+/// - 0: The number of worker threads.
+void
+BM_parallel_transform(benchmark::State & state)
+{
+  ywen::vector<uint64_t> v;
+  make_random(v);
+
+  ywen::thread_pool pool(static_cast<size_t>(state.range(0)));
+  ywen::vector<uint64_t> out;
+
+  for (auto _ : state)
+  {
+    ywen::parallel_transform(pool, v, out, [](uint64_t x) {
+      x ^= x >> 33;
+      x *= 0xff51afd7ed558ccdULL;
+      return x ^ (x >> 33);
+    });
+  }
+
+  state.SetItemsProcessed(
+    static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(COUNT));
+}
+
+/// Sum `COUNT` numbers.
+///
+/// Arguments:
+/// - 0: The number of worker threads.
+void
+BM_parallel_reduce(benchmark::State & state)
+{
+  ywen::vector<uint64_t> v;
+  make_random(v);
+
+  ywen::thread_pool pool(static_cast<size_t>(state.range(0)));
+
+  for (auto _ : state)
+  {
+    benchmark::DoNotOptimize(
+      ywen::parallel_reduce(pool, v, uint64_t(0), std::plus<>()));
+  }
+
+  state.SetBytesProcessed(
+    static_cast<int64_t>(state.iterations()) *
+    static_cast<int64_t>(COUNT * sizeof(uint64_t)));
+}
+
+/// Run with 0 (only the calling thread, i.e., 1 core) up to N - 1 worker
+/// threads (N cores), and at least up to 3.
+void
+thread_counts(benchmark::internal::Benchmark * b)
+{
+  const int64_t cores =
+    std::max<int64_t>(4, std::thread::hardware_concurrency());
+  for (int64_t threads = 0; threads < cores; ++threads)
+  {
+    b->Arg(threads);
+  }
+}
+
+/// The number of entries of the routing table of the reader benchmarks.
+constexpr size_t TABLE_SIZE = 4096;
+
+/// The time between the updates of the writer of the reader benchmarks.
+constexpr std::chrono::microseconds UPDATE_INTERVAL(100);
+
+/// Run `update(k)` for k = 1, 2, ... on a writer thread every
+/// `UPDATE_INTERVAL` while the benchmark thread 0 runs.
+template<typename _Fn>
+class background_writer
+{
+public:
+  background_writer(benchmark::State & state, _Fn update)
+    : m_enabled(0 == state.thread_index()), m_done(false)
+  {
+    if (m_enabled)
+    {
+      m_thread = std::thread([this, update]() {
+        for (uint64_t k = 1; !m_done.load(); ++k)
+        {
+          update(k);
+          std::this_thread::sleep_for(UPDATE_INTERVAL);
+        }
+      });
+    }
+  }
+
+  ~background_writer()
+  {
+    if (m_enabled)
+    {
+      m_done = true;
+      m_thread.join();
+    }
+  }
+
+private:
+  const bool m_enabled;
+  std::atomic<bool> m_done;
+  std::thread m_thread;
+};
+
+/// Look up the routing table through snapshots, while a writer publishes a
+/// new version every `UPDATE_INTERVAL`.
+void
+BM_read_snapshot(benchmark::State & state)
+{
+  // The static local is initialized once, before any thread uses it.
+  static ywen::snapshot_vector<uint64_t> & table = []() -> auto & {
+    static ywen::snapshot_vector<uint64_t> t;
+    t.update([](ywen::vector<uint64_t> & v) { v.resize(TABLE_SIZE); });
+    return t;
+  }();
+
+  background_writer writer(state, [](uint64_t k) {
+    table.update([k](ywen::vector<uint64_t> & v) { v[k % TABLE_SIZE] = k; });
+  });
+
+  uint64_t sum = 0;
+  size_t i = static_cast<size_t>(state.thread_index()) * 7919;
+  for (auto _ : state)
+  {
+    ywen::snapshot_vector<uint64_t>::snapshot s = table.load();
+    sum += s[i++ % TABLE_SIZE];
+  }
+  benchmark::DoNotOptimize(sum);
+
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+/// The same lookups in a `vector` guarded by a `_Mutex`, which the readers
+/// lock with `_Lock` and the writer locks exclusively.
+template<typename _Mutex, typename _Lock>
+void
+BM_read_locked(benchmark::State & state)
+{
+  static _Mutex mutex;
+  static ywen::vector<uint64_t> & table = []() -> auto & {
+    static ywen::vector<uint64_t> t;
+    t.resize(TABLE_SIZE);
+    return t;
+  }();
+
+  background_writer writer(state, [](uint64_t k) {
+    std::lock_guard<_Mutex> lock(mutex);
+    table[k % TABLE_SIZE] = k;
+  });
+
+  uint64_t sum = 0;
+  size_t i = static_cast<size_t>(state.thread_index()) * 7919;
+  for (auto _ : state)
+  {
+    _Lock lock(mutex);
+    sum += table[i++ % TABLE_SIZE];
+  }
+  benchmark::DoNotOptimize(sum);
+
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+/// Run with 1 up to N reader threads (N cores), and at least up to 4.
+void
+reader_counts(benchmark::internal::Benchmark * b)
+{
+  const int cores =
+    std::max<int>(4, static_cast<int>(std::thread::hardware_concurrency()));
+  b->DenseThreadRange(1, cores);
+}
+
+#ifdef YWEN_VECTOR_BASIC_GUARANTEE
+/// The exception guarantee of `insert` and `erase` in this build.
+constexpr char const * GUARANTEE = "basic";
+#else
+constexpr char const * GUARANTEE = "strong";
+#endif
+
+/// Set the ith element of the `insert`/`erase` benchmarks.
+void
+make_element(size_t i, uint64_t & e)
+{
+  e = i;
+}
+
+void
+make_element(size_t i, std::string & e)
+{
+  // Too long for the small string optimization, so copies allocate.
+  e = std::string(32, static_cast<char>('a' + i % 26));
+}
+
+/// Insert an element in the middle of a vector of `state.range(0)` elements
+/// and erase it. Run it in both `bench_vector` and `bench_vector_basic` to
+/// measure what the strong guarantee costs.
+template<typename _Ty>
+void
+BM_insert_erase(benchmark::State & state)
+{
+  const size_t count = static_cast<size_t>(state.range(0));
+
+  ywen::vector<_Ty> v;
+  v.resize(count);
+  for (size_t i = 0; i < count; ++i)
+  {
+    make_element(i, v[i]);
+  }
+  _Ty value;
+  make_element(count, value);
+
+  // Grow the buffer once, so only the first `insert` has to.
+  v.insert(count / 2, value);
+  v.erase(count / 2);
+
+  for (auto _ : state)
+  {
+    v.insert(count / 2, value);
+    v.erase(count / 2);
+  }
+
+  state.SetLabel(GUARANTEE);
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * 2);
+}
+
+/// Return the size of the anonymous memory of the process that is backed by
+/// transparent huge pages, in MiB, or -1 if it's unknown.
+double
+huge_page_mib()
+{
+  std::ifstream smaps("/proc/self/smaps_rollup");
+  std::string key;
+  while (smaps >> key)
+  {
+    if ("AnonHugePages:" == key)
+    {
+      double kib = 0;
+      smaps >> kib;
+      return kib / 1024;
+    }
+    smaps.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+  }
+  return -1;
+}
+
+/// Read random elements of a vector of `state.range(0)` GiB that is stored
+/// with `_Storage`. The vector is first touched in parallel.
+template<typename _Storage>
+void
+BM_random_access(benchmark::State & state)
+{
+  const size_t count = (static_cast<size_t>(state.range(0)) << 30) /
+                       sizeof(uint64_t);
+
+  ywen::thread_pool pool;
+  ywen::vector<uint64_t, _Storage> v;
+  v.resize(count);
+  ywen::parallel_first_touch(pool, v);
+
+  // `count` is a power of 2, so the index is masked to the range.
+  uint64_t x = 88172645463325252ULL;
+  uint64_t sum = 0;
+  for (auto _ : state)
+  {
+    for (int i = 0; i < 1024; ++i)
+    {
+      x ^= x << 13;
+      x ^= x >> 7;
+      x ^= x << 17;
+      sum += v[x & (count - 1)];
+    }
+  }
+  benchmark::DoNotOptimize(sum);
+
+  state.counters["huge_MiB"] = huge_page_mib();
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * 1024);
+}
+
+}  // namespace
+
+BENCHMARK_TEMPLATE(BM_insert_erase, uint64_t)
+  ->RangeMultiplier(16)
+  ->Range(16, 16 << 10)
+  ->ArgName("size");
+BENCHMARK_TEMPLATE(BM_insert_erase, std::string)
+  ->RangeMultiplier(16)
+  ->Range(16, 16 << 10)
+  ->ArgName("size");
+
+BENCHMARK_TEMPLATE(BM_random_access, ywen::new_storage<uint64_t>)
+  ->Arg(1)
+  ->Arg(2)
+  ->ArgName("GiB");
+BENCHMARK_TEMPLATE(BM_random_access, ywen::huge_page_storage<uint64_t>)
+  ->Arg(1)
+  ->Arg(2)
+  ->ArgName("GiB");
+
+BENCHMARK(BM_read_snapshot)->Apply(reader_counts)->UseRealTime();
+BENCHMARK_TEMPLATE(
+  BM_read_locked,
+  std::mutex,
+  std::lock_guard<std::mutex>)
+  ->Apply(reader_counts)
+  ->UseRealTime();
+BENCHMARK_TEMPLATE(
+  BM_read_locked,
+  std::shared_mutex,
+  std::shared_lock<std::shared_mutex>)
+  ->Apply(reader_counts)
+  ->UseRealTime();
+
+BENCHMARK(BM_parallel_sort)
+  ->Arg(-1)
+  ->Apply(thread_counts)
+  ->ArgName("threads")
+  ->UseRealTime()
+  ->Unit(benchmark::kMillisecond);
+
+BENCHMARK(BM_parallel_transform)
+  ->Apply(thread_counts)
+  ->ArgName("threads")
+  ->UseRealTime()
+  ->Unit(benchmark::kMillisecond);
+
+BENCHMARK(BM_parallel_reduce)
+  ->Apply(thread_counts)
+  ->ArgName("threads")
+  ->UseRealTime()
+  ->Unit(benchmark::kMillisecond);
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <new>
+#include <type_traits>
+
+#include <sys/mman.h>
+
+#include "../thread_pool/thread_pool.hpp"
+#include "vector.hpp"
+
+namespace ywen
+{
+
+/// The size of a transparent huge page on x86-64 (and of the PMD-level pages
+/// of most other 64-bit architectures).
+constexpr size_t HUGE_PAGE_SIZE = 2U << 20;
+
+/// A storage policy of `vector` for big buffers: the buffers of at least
+/// `HUGE_PAGE_SIZE` bytes are mapped with `mmap`, aligned to
+/// `HUGE_PAGE_SIZE`, and advised with `madvise(MADV_HUGEPAGE)` so the kernel
+/// backs them with transparent huge pages, which cuts the TLB misses of
+/// random access. The smaller buffers are allocated with `new[]`.
+///
+/// If the kernel doesn't support transparent huge pages (or they are
+/// disabled), `madvise` fails and is ignored, and the buffers are backed by
+/// normal pages.
+///
+/// The pages are not touched when a buffer of a trivially
+/// default-constructible type is allocated, so they are placed (on a NUMA
+/// machine) near the thread that writes them first, e.g., by
+/// `parallel_first_touch`.
+template<typename _Ty>
+struct huge_page_storage
+{
+  /// Throws:
+  /// - `std::bad_alloc`: When out of memory.
+  /// - Exceptions thrown by _Ty's default constructor.
+  static _Ty *
+  allocate(const size_t count);
+
+  static void
+  deallocate(_Ty * p, const size_t count) noexcept;
+
+  /// Return the size of the mapping of `count` elements, or 0 if they are
+  /// allocated with `new[]`.
+  static size_t
+  mapping_size(const size_t count) noexcept;
+};
+
+template<class _Ty>
+size_t
+huge_page_storage<_Ty>::mapping_size(const size_t count) noexcept
+{
+  if (count < HUGE_PAGE_SIZE / sizeof(_Ty))
+  {
+    return 0;
+  }
+
+  // Round up to whole huge pages, so the last one can be a huge page too.
+  // `allocate` has checked that it doesn't overflow.
+  const size_t bytes = count * sizeof(_Ty);
+  return (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+}
+
+template<class _Ty>
+_Ty *
+huge_page_storage<_Ty>::allocate(const size_t count)
+{
+  if (count > (std::numeric_limits<size_t>::max() - 2 * HUGE_PAGE_SIZE) /
+                sizeof(_Ty))
+  {
+    throw std::bad_alloc();
+  }
+
+  const size_t size = mapping_size(count);
+  if (0 == size)
+  {
+    return new_storage<_Ty>::allocate(count);
+  }
+
+  // Map an extra huge page, so an aligned range of `size` bytes fits in it,
+  // and unmap the rest.
+  void * const mapped = mmap(
+    nullptr,
+    size + HUGE_PAGE_SIZE,
+    PROT_READ | PROT_WRITE,
+    MAP_PRIVATE | MAP_ANONYMOUS,
+    -1,
+    0);
+  if (MAP_FAILED == mapped)
+  {
+    throw std::bad_alloc();
+  }
+
+  const uintptr_t begin = reinterpret_cast<uintptr_t>(mapped);
+  const uintptr_t aligned =
+    (begin + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+  if (aligned > begin)
+  {
+    munmap(mapped, aligned - begin);
+  }
+  if (begin + HUGE_PAGE_SIZE > aligned)
+  {
+    munmap(
+      reinterpret_cast<void *>(aligned + size),
+      begin + HUGE_PAGE_SIZE - aligned);
+  }
+
+  void * const p = reinterpret_cast<void *>(aligned);
+
+  // A failure only means normal pages.
+  madvise(p, size, MADV_HUGEPAGE);
+
+  // The mapping is zero-filled on demand, so the elements of a trivially
+  // default-constructible type are left indeterminate (as `new[]` does), and
+  // the pages are not touched.
+  _Ty * const elements = static_cast<_Ty *>(p);
+  if (!std::is_trivially_default_constructible<_Ty>::value)
+  {
+    size_t i = 0;
+    try
+    {
+      for (; i < count; ++i)
+      {
+        ::new (static_cast<void *>(elements + i)) _Ty;
+      }
+    }
+    catch (...)
+    {
+      while (i > 0)
+      {
+        elements[--i].~_Ty();
+      }
+      munmap(p, size);
+      throw;
+    }
+  }
+
+  return elements;
+}
+
+template<class _Ty>
+void
+huge_page_storage<_Ty>::deallocate(_Ty * p, const size_t count) noexcept
+{
+  const size_t size = mapping_size(count);
+  if (0 == size)
+  {
+    new_storage<_Ty>::deallocate(p, count);
+    return;
+  }
+
+  if (!std::is_trivially_destructible<_Ty>::value)
+  {
+    for (size_t i = count; i > 0; --i)
+    {
+      p[i - 1].~_Ty();
+    }
+  }
+
+  munmap(p, size);
+}
+
+/// Assign `_Ty()` to the elements of `v` in parallel pieces of `grain`
+/// elements, so each page is first touched by, and therefore placed on the
+/// NUMA node of, the thread that takes the piece. To access the elements
+/// mostly from the node they are on, process them with the same pool and
+/// grain afterwards (e.g., with `parallel_for_each`); work stealing moves a
+/// few pieces to other threads.
+///
+/// It should be called right after `v` is resized from empty, before the
+/// elements are touched (and `_Ty` should be trivially default-constructible
+/// for `huge_page_storage` to leave them untouched). The default grain is a
+/// huge page.
+///
+/// Throws:
+/// - `std::bad_alloc`: When out of memory.
+/// - Exceptions thrown by _Ty's default constructor and assignment operator.
+template<typename _Ty, typename _Storage>
+void
+parallel_first_touch(
+  thread_pool & pool,
+  vector<_Ty, _Storage> & v,
+  size_t grain = (HUGE_PAGE_SIZE + sizeof(_Ty) - 1) / sizeof(_Ty))
+{
+  _Ty * const data = v.data();
+  pool.parallel_for(0, v.size(), grain, [data](size_t b, size_t e) {
+    for (size_t i = b; i < e; ++i)
+    {
+      data[i] = _Ty();
+    }
+  });
+}
+
+}  // namespace ywen
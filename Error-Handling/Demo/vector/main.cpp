@@ -1,9 +1,45 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../thread_pool/thread_pool.hpp"
+#include "huge_page_storage.hpp"
+#include "parallel_algorithm.hpp"
+#include "snapshot_vector.hpp"
 #include "vector.hpp"
 
+using ywen::snapshot_vector;
+using ywen::thread_pool;
 using ywen::vector;
 
+namespace
+{
+
+/// Fill `v` with `count` pseudo-random numbers below `limit`.
+void
+make_random(vector<uint32_t> & v, size_t count, uint32_t limit)
+{
+  std::mt19937 rng(static_cast<uint32_t>(count));
+  std::uniform_int_distribution<uint32_t> dist(0, limit - 1);
+
+  v.resize(count);
+  for (size_t i = 0; i < count; ++i)
+  {
+    v[i] = dist(rng);
+  }
+}
+
+}  // namespace
+
 TEST(Test_ywen_vector, test_constructor_empty)
 {
   {
@@ -177,3 +213,812 @@ TEST(Test_ywen_vector, test_regular_use)
     EXPECT_TRUE(v.empty());
   }
 }
+
+TEST(Test_ywen_vector, test_grow)
+{
+  vector<size_t> v;
+
+  const size_t N = 1000;
+  for (size_t i = 0; i < N; ++i)
+  {
+    v.insert(i / 2, i);
+    EXPECT_LE(v.size(), v.capacity());
+  }
+  EXPECT_EQ(N, v.size());
+}
+
+TEST(Test_ywen_vector, test_resize)
+{
+  {
+    vector<int> v = {1, 2, 3};
+
+    v.resize(1000);
+    EXPECT_EQ(1000U, v.size());
+    EXPECT_EQ(1000U, v.capacity());
+    EXPECT_EQ(1, v.at(0));
+    EXPECT_EQ(3, v.at(2));
+
+    v.resize(2);
+    EXPECT_EQ(2U, v.size());
+    EXPECT_EQ(1000U, v.capacity());
+    EXPECT_EQ(2, v.at(1));
+
+    v.resize(0);
+    EXPECT_TRUE(v.empty());
+  }
+
+  {
+    // The elements that are added back within the capacity are
+    // default-constructed rather than the erased values.
+    vector<std::string> v = {"a", "b", "c"};
+
+    v.resize(1);
+    v.resize(3);
+    EXPECT_EQ("a", v.at(0));
+    EXPECT_EQ("", v.at(1));
+    EXPECT_EQ("", v.at(2));
+  }
+}
+
+TEST(Test_ywen_vector, test_swap)
+{
+  vector<int> a = {1, 2, 3};
+  vector<int> b;
+
+  a.swap(b);
+  EXPECT_TRUE(a.empty());
+  EXPECT_EQ(3U, b.size());
+  EXPECT_EQ(3, b.at(2));
+
+  a.swap(b);
+  EXPECT_EQ(3U, a.size());
+  EXPECT_TRUE(b.empty());
+}
+
+TEST(Test_ywen_vector_parallel, test_parallel_for_each)
+{
+  thread_pool pool(3);
+
+  vector<uint32_t> v;
+  make_random(v, 100000, 1000);
+  vector<uint32_t> expected;
+  make_random(expected, 100000, 1000);
+
+  for (size_t grain : {1U, 1000U, 1U << 20})
+  {
+    ywen::parallel_for_each(
+      pool, v, [](uint32_t & x) { x += 1; }, grain);
+  }
+
+  for (size_t i = 0; i < v.size(); ++i)
+  {
+    EXPECT_EQ(expected[i] + 3, v[i]);
+  }
+}
+
+TEST(Test_ywen_vector_parallel, test_parallel_transform)
+{
+  thread_pool pool(3);
+
+  vector<uint32_t> v;
+  make_random(v, 100000, 1000);
+
+  vector<uint64_t> squares = {42};
+  ywen::parallel_transform(
+    pool, v, squares, [](uint32_t x) { return uint64_t(x) * x; }, 100);
+  ASSERT_EQ(v.size(), squares.size());
+  for (size_t i = 0; i < v.size(); ++i)
+  {
+    EXPECT_EQ(uint64_t(v[i]) * v[i], squares[i]);
+  }
+
+  // In place.
+  ywen::parallel_transform(pool, v, v, [](uint32_t x) { return x + 1; });
+  for (size_t i = 0; i < v.size(); ++i)
+  {
+    EXPECT_EQ(squares[i], uint64_t(v[i] - 1) * (v[i] - 1));
+  }
+
+  // Strong guarantee: `dst` is not changed when `fn` throws.
+  vector<uint32_t> dst = {1, 2, 3};
+  EXPECT_THROW(
+    ywen::parallel_transform(
+      pool,
+      v,
+      dst,
+      [](uint32_t x) -> uint32_t {
+        if (x > 900)
+        {
+          throw std::runtime_error("too big");
+        }
+        return x;
+      },
+      10),
+    std::runtime_error);
+  ASSERT_EQ(3U, dst.size());
+  EXPECT_EQ(3U, dst[2]);
+}
+
+TEST(Test_ywen_vector_parallel, test_parallel_reduce)
+{
+  thread_pool pool(3);
+
+  vector<uint32_t> v;
+  make_random(v, 100001, 1000);
+
+  uint64_t expected = 7;
+  for (size_t i = 0; i < v.size(); ++i)
+  {
+    expected += v[i];
+  }
+
+  for (size_t grain : {0U, 1U, 999U, 1U << 20})
+  {
+    EXPECT_EQ(
+      expected,
+      ywen::parallel_reduce(pool, v, uint64_t(7), std::plus<>(), grain));
+  }
+
+  // The elements are combined in order.
+  vector<std::string> words = {"a", "b", "c", "d", "e", "f", "g"};
+  for (size_t grain : {1U, 2U, 3U, 100U})
+  {
+    EXPECT_EQ(
+      ">abcdefg",
+      ywen::parallel_reduce(
+        pool, words, std::string(">"), std::plus<>(), grain));
+  }
+
+  vector<uint32_t> empty;
+  EXPECT_EQ(5U, ywen::parallel_reduce(pool, empty, 5U, std::plus<>()));
+}
+
+TEST(Test_ywen_vector_parallel, test_parallel_sort)
+{
+  for (size_t threads : {0U, 1U, 4U})
+  {
+    thread_pool pool(threads);
+
+    for (size_t count : {0U, 1U, 2U, 17U, 1000U, 100003U})
+    {
+      for (size_t grain : {1U, 64U, 1U << 14})
+      {
+        // Many equal elements, to check the merge split.
+        vector<uint32_t> v;
+        make_random(v, count, 100);
+        std::vector<uint32_t> expected(v.data(), v.data() + v.size());
+        std::sort(expected.begin(), expected.end());
+
+        ywen::parallel_sort(pool, v, std::less<uint32_t>(), grain);
+        ASSERT_EQ(count, v.size());
+        for (size_t i = 0; i < count; ++i)
+        {
+          ASSERT_EQ(expected[i], v[i]);
+        }
+      }
+    }
+  }
+
+  // Descending order.
+  thread_pool pool(2);
+  vector<uint32_t> v;
+  make_random(v, 10000, 1U << 30);
+  ywen::parallel_sort(pool, v, std::greater<uint32_t>(), 100);
+  for (size_t i = 1; i < v.size(); ++i)
+  {
+    ASSERT_GE(v[i - 1], v[i]);
+  }
+}
+
+TEST(Test_ywen_vector_parallel, test_parallel_sort_exception)
+{
+  thread_pool pool(3);
+
+  vector<uint32_t> v;
+  make_random(v, 100000, 1000);
+  vector<uint32_t> original;
+  make_random(original, 100000, 1000);
+
+  // Count the comparisons of a sort (of a copy).
+  std::atomic<size_t> calls(0);
+  size_t limit = 0;
+  auto comp = [&calls, &limit](uint32_t a, uint32_t b) {
+    if (++calls > limit)
+    {
+      throw std::runtime_error("comparator");
+    }
+    return a < b;
+  };
+  {
+    vector<uint32_t> copy;
+    make_random(copy, 100000, 1000);
+    limit = size_t(-1);
+    ywen::parallel_sort(pool, copy, comp, 1000);
+  }
+  const size_t total = calls.load();
+
+  // The comparator throws in the sort of a piece, or in the last merge.
+  for (size_t l : {size_t(10), total - 1000})
+  {
+    calls = 0;
+    limit = l;
+
+    EXPECT_THROW(
+      ywen::parallel_sort(pool, v, comp, 1000), std::runtime_error);
+
+    // Strong guarantee: `v` is not changed.
+    ASSERT_EQ(original.size(), v.size());
+    for (size_t i = 0; i < v.size(); ++i)
+    {
+      ASSERT_EQ(original[i], v[i]);
+    }
+  }
+}
+
+TEST(Test_ywen_snapshot_vector, test_update)
+{
+  snapshot_vector<std::string> sv;
+
+  snapshot_vector<std::string>::snapshot s0 = sv.load();
+  EXPECT_EQ(0U, s0.size());
+
+  sv.update([](vector<std::string> & v) {
+    v.push_back("a");
+    v.push_back("c");
+    v.insert(1, "b");
+  });
+
+  // The old snapshot is not changed.
+  EXPECT_EQ(0U, s0.size());
+
+  snapshot_vector<std::string>::snapshot s1 = sv.load();
+  ASSERT_EQ(3U, s1.size());
+  EXPECT_EQ("b", s1[1]);
+
+  sv.update([](vector<std::string> & v) { v.erase(0); });
+  EXPECT_EQ(3U, s1->size());
+  EXPECT_EQ("b", (*sv.load())[0]);
+
+  // The versions of `s0` and `s1` are retired but still referred to.
+  EXPECT_EQ(2U, sv.reclaim());
+  {
+    snapshot_vector<std::string>::snapshot moved = std::move(s0);
+  }
+  EXPECT_EQ(1U, sv.reclaim());
+  s1 = sv.load();
+  EXPECT_EQ(0U, sv.reclaim());
+  EXPECT_EQ(2U, s1.size());
+}
+
+TEST(Test_ywen_snapshot_vector, test_exception_safety)
+{
+  snapshot_vector<int> sv;
+  sv.update([](vector<int> & v) { v.push_back(1); });
+
+  EXPECT_THROW(
+    sv.update([](vector<int> & v) {
+      v.push_back(2);
+      throw std::runtime_error("update");
+    }),
+    std::runtime_error);
+
+  // Nothing is published.
+  ASSERT_EQ(1U, sv.load().size());
+  EXPECT_EQ(1, sv.load()[0]);
+  EXPECT_EQ(0U, sv.reclaim());
+}
+
+TEST(Test_ywen_snapshot_vector, test_concurrent_readers)
+{
+  // Version k holds k elements that are all k, so a reader can check that
+  // its snapshot is consistent.
+  snapshot_vector<size_t> sv;
+  std::atomic<bool> done(false);
+  std::atomic<size_t> errors(0);
+
+  std::vector<std::thread> readers;
+  for (int r = 0; r < 4; ++r)
+  {
+    readers.emplace_back([&sv, &done, &errors]() {
+      size_t last = 0;
+      while (!done.load())
+      {
+        snapshot_vector<size_t>::snapshot s = sv.load();
+        const size_t k = s.size();
+        for (size_t i = 0; i < k; ++i)
+        {
+          errors += (s[i] != k ? 1 : 0);
+        }
+
+        // The versions are seen in order.
+        errors += (k < last ? 1 : 0);
+        last = k;
+      }
+    });
+  }
+
+  // More updates than `MAX_VERSIONS`, so the slots are reused.
+  for (size_t k = 1; k <= 1500; ++k)
+  {
+    sv.update([k](vector<size_t> & v) {
+      v.push_back(k);
+      for (size_t i = 0; i < v.size(); ++i)
+      {
+        v[i] = k;
+      }
+    });
+  }
+
+  done = true;
+  for (std::thread & t : readers)
+  {
+    t.join();
+  }
+
+  EXPECT_EQ(0U, errors.load());
+  EXPECT_EQ(1500U, sv.load().size());
+  EXPECT_EQ(0U, sv.reclaim());
+}
+
+TEST(Test_ywen_vector_storage, test_huge_page_storage)
+{
+  using storage = ywen::huge_page_storage<uint64_t>;
+  const size_t big = ywen::HUGE_PAGE_SIZE / sizeof(uint64_t);
+
+  EXPECT_EQ(0U, storage::mapping_size(big - 1));
+  EXPECT_EQ(ywen::HUGE_PAGE_SIZE, storage::mapping_size(big));
+  EXPECT_EQ(2 * ywen::HUGE_PAGE_SIZE, storage::mapping_size(big + 1));
+
+  // Grow from `new[]` to mapped buffers.
+  vector<uint64_t, storage> v = {0, 1, 2};
+  v.resize(big - 1);
+  v.push_back(big - 1);
+  for (size_t i = 3; i < v.size(); ++i)
+  {
+    v[i] = i;
+  }
+  v.resize(3 * big + 1);
+  ASSERT_EQ(3 * big + 1, v.size());
+  EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(v.data()) % ywen::HUGE_PAGE_SIZE);
+  for (size_t i = 0; i < big; ++i)
+  {
+    ASSERT_EQ(i, v[i]);
+  }
+
+  v.erase(0);
+  EXPECT_EQ(1U, v[0]);
+  v.insert(0, 42);
+  EXPECT_EQ(42U, v[0]);
+}
+
+TEST(Test_ywen_vector_storage, test_huge_page_storage_non_trivial)
+{
+  vector<std::string, ywen::huge_page_storage<std::string>> v;
+  v.resize(ywen::HUGE_PAGE_SIZE / sizeof(std::string) * 2);
+
+  for (size_t i = 0; i < v.size(); i += 1000)
+  {
+    EXPECT_TRUE(v[i].empty());
+    v[i] = std::string(100, 'x');
+  }
+  v.resize(v.size() + 1);
+  EXPECT_EQ(100U, v[1000].size());
+}
+
+namespace
+{
+
+/// An element whose default constructor throws after `budget` calls.
+struct counted
+{
+  static int budget;
+  static int alive;
+
+  counted()
+  {
+    if (0 == budget--)
+    {
+      throw std::runtime_error("constructor");
+    }
+    ++alive;
+  }
+
+  counted(counted const &) = delete;
+
+  counted &
+  operator=(counted const &) = default;
+
+  ~counted()
+  {
+    --alive;
+  }
+};
+
+int counted::budget = 0;
+int counted::alive = 0;
+
+}  // namespace
+
+TEST(Test_ywen_vector_storage, test_huge_page_storage_exception)
+{
+  vector<counted, ywen::huge_page_storage<counted>> v;
+  const size_t count = ywen::HUGE_PAGE_SIZE;
+
+  // The elements that have been constructed are destroyed.
+  counted::budget = 1000;
+  EXPECT_THROW(v.resize(count), std::runtime_error);
+  EXPECT_EQ(0, counted::alive);
+  EXPECT_TRUE(v.empty());
+
+  counted::budget = static_cast<int>(count);
+  v.resize(count);
+  EXPECT_EQ(static_cast<int>(count), counted::alive);
+}
+
+TEST(Test_ywen_vector_storage, test_parallel_first_touch)
+{
+  thread_pool pool(3);
+
+  vector<uint32_t, ywen::huge_page_storage<uint32_t>> v;
+  v.resize(3 * ywen::HUGE_PAGE_SIZE / sizeof(uint32_t) + 5);
+  ywen::parallel_first_touch(pool, v);
+  for (size_t i = 0; i < v.size(); ++i)
+  {
+    ASSERT_EQ(0U, v[i]);
+  }
+
+  vector<uint32_t> small;
+  make_random(small, 1000, 100);
+  ywen::parallel_first_touch(pool, small, 10);
+  EXPECT_EQ(0U, ywen::parallel_reduce(pool, small, 0U, std::plus<>()));
+}
+
+namespace
+{
+
+#ifdef YWEN_VECTOR_BASIC_GUARANTEE
+/// Whether `insert` and `erase` give only the basic guarantee when the
+/// buffer doesn't have to grow.
+constexpr bool BASIC_IN_PLACE = true;
+#else
+constexpr bool BASIC_IN_PLACE = false;
+#endif
+
+/// The exception thrown by an injected fault.
+struct injected_fault : std::runtime_error
+{
+  using std::runtime_error::runtime_error;
+};
+
+/// Counts the copies, moves and allocations of `faulty` and
+/// `faulty_storage`, and makes the Nth one (0-based) throw after `arm(n)`.
+struct fault_injector
+{
+  /// The number of operations left before the fault; negative when no
+  /// fault is armed.
+  static long countdown;
+
+  /// The number of `faulty` objects and `faulty_storage` buffers alive.
+  static long alive;
+  static long buffers;
+
+  static void
+  arm(long n)
+  {
+    countdown = n;
+  }
+
+  static void
+  disarm()
+  {
+    countdown = -1;
+  }
+
+  /// Count an operation, and throw if it's the armed one. Only one fault is
+  /// injected per `arm`.
+  static void
+  hit(char const * what)
+  {
+    if (countdown >= 0 && 0 == countdown--)
+    {
+      throw injected_fault(what);
+    }
+  }
+};
+
+long fault_injector::countdown = -1;
+long fault_injector::alive = 0;
+long fault_injector::buffers = 0;
+
+/// An element whose copies and moves are counted by `fault_injector`. A
+/// moved-from element has the value -1.
+struct faulty
+{
+  int value;
+
+  faulty() : value(0)
+  {
+    ++fault_injector::alive;
+  }
+
+  faulty(int v) : value(v)
+  {
+    ++fault_injector::alive;
+  }
+
+  faulty(faulty const & other) : value(other.value)
+  {
+    fault_injector::hit("copy");
+    ++fault_injector::alive;
+  }
+
+  faulty(faulty && other) : value(other.value)
+  {
+    fault_injector::hit("move");
+    other.value = -1;
+    ++fault_injector::alive;
+  }
+
+  faulty &
+  operator=(faulty const & other)
+  {
+    fault_injector::hit("copy");
+    value = other.value;
+    return *this;
+  }
+
+  faulty &
+  operator=(faulty && other)
+  {
+    fault_injector::hit("move");
+    value = other.value;
+    other.value = -1;
+    return *this;
+  }
+
+  ~faulty()
+  {
+    --fault_injector::alive;
+  }
+};
+
+/// A storage policy whose allocations are counted by `fault_injector`.
+struct faulty_storage
+{
+  static faulty *
+  allocate(const size_t count)
+  {
+    fault_injector::hit("allocation");
+    faulty * p = ywen::new_storage<faulty>::allocate(count);
+    ++fault_injector::buffers;
+    return p;
+  }
+
+  static void
+  deallocate(faulty * p, const size_t count) noexcept
+  {
+    --fault_injector::buffers;
+    ywen::new_storage<faulty>::deallocate(p, count);
+  }
+};
+
+using faulty_vector = vector<faulty, faulty_storage>;
+
+/// Make `v` hold `size` elements 0, 1, ... in a buffer of `capacity` slots.
+void
+make_faulty(faulty_vector & v, const size_t size, const size_t capacity)
+{
+  v.resize(capacity);
+  for (size_t i = 0; i < capacity; ++i)
+  {
+    v[i] = faulty(static_cast<int>(i));
+  }
+  while (v.size() > size)
+  {
+    v.pop_back();  // Doesn't shrink the buffer.
+  }
+}
+
+/// Check that no `faulty` object or buffer is alive except the ones of `v`.
+void
+expect_no_leak(faulty_vector const & v)
+{
+  EXPECT_EQ(v.capacity() > 0 ? 1 : 0, fault_injector::buffers);
+  EXPECT_EQ(static_cast<long>(v.capacity()), fault_injector::alive);
+}
+
+/// Run `op(v)` on a vector made by `make_faulty(v, size, capacity)`, with a
+/// fault injected into the Nth copy, move or allocation, for N = 0, 1, ...
+/// until `op` succeeds, and then call `check(v)`.
+///
+/// After every fault, it checks that nothing leaks, that the vector is
+/// unchanged if `strong`, and that it's still usable otherwise (the basic
+/// guarantee). Returns the number of faults injected.
+template<typename _Op, typename _Check>
+long
+sweep_faults(
+  const size_t size,
+  const size_t capacity,
+  const bool strong,
+  _Op op,
+  _Check check)
+{
+  const long MAX_FAULTS = 10000;
+
+  for (long n = 0; n < MAX_FAULTS; ++n)
+  {
+    faulty_vector v;
+    make_faulty(v, size, capacity);
+
+    fault_injector::arm(n);
+    try
+    {
+      op(v);
+    }
+    catch (injected_fault const &)
+    {
+      fault_injector::disarm();
+
+      SCOPED_TRACE("fault " + std::to_string(n));
+      expect_no_leak(v);
+      EXPECT_LE(v.size(), v.capacity());
+      if (strong)
+      {
+        EXPECT_EQ(size, v.size());
+        EXPECT_EQ(capacity, v.capacity());
+        for (size_t i = 0; i < v.size(); ++i)
+        {
+          EXPECT_EQ(static_cast<int>(i), v[i].value);
+        }
+      }
+
+      v.push_back(faulty(42));
+      EXPECT_EQ(42, v[v.size() - 1].value);
+      continue;
+    }
+
+    fault_injector::disarm();
+    expect_no_leak(v);
+    check(v);
+    return n;
+  }
+
+  ADD_FAILURE() << "the operation never succeeds";
+  return MAX_FAULTS;
+}
+
+}  // namespace
+
+TEST(Test_ywen_vector_fault_injection, test_insert)
+{
+  const size_t SIZE = 6;
+
+  // Full (so the buffer grows) and not full.
+  for (const size_t capacity : {SIZE, 2 * SIZE})
+  {
+    const bool strong = (SIZE == capacity || !BASIC_IN_PLACE);
+    for (size_t index = 0; index <= SIZE; ++index)
+    {
+      SCOPED_TRACE(
+        "capacity " + std::to_string(capacity) + ", index " +
+        std::to_string(index));
+
+      const long faults = sweep_faults(
+        SIZE,
+        capacity,
+        strong,
+        [index](faulty_vector & v) { v.insert(index, faulty(42)); },
+        [index](faulty_vector const & v) {
+          ASSERT_EQ(SIZE + 1, v.size());
+          for (size_t i = 0; i < v.size(); ++i)
+          {
+            const int expected =
+              (i < index ? static_cast<int>(i)
+                         : i == index ? 42 : static_cast<int>(i - 1));
+            EXPECT_EQ(expected, v[i].value);
+          }
+        });
+      EXPECT_GT(faults, 0);
+    }
+
+    // The inserted value is an element that is moved.
+    sweep_faults(
+      SIZE,
+      capacity,
+      strong,
+      [](faulty_vector & v) { v.insert(1, v[4]); },
+      [](faulty_vector const & v) {
+        ASSERT_EQ(SIZE + 1, v.size());
+        EXPECT_EQ(0, v[0].value);
+        EXPECT_EQ(4, v[1].value);
+        EXPECT_EQ(1, v[2].value);
+        EXPECT_EQ(5, v[6].value);
+      });
+  }
+}
+
+TEST(Test_ywen_vector_fault_injection, test_erase)
+{
+  const size_t SIZE = 6;
+
+  for (const size_t capacity : {SIZE, 2 * SIZE})
+  {
+    for (size_t index = 0; index < SIZE; ++index)
+    {
+      SCOPED_TRACE(
+        "capacity " + std::to_string(capacity) + ", index " +
+        std::to_string(index));
+
+      // Erasing the last element copies nothing.
+      const long faults = sweep_faults(
+        SIZE,
+        capacity,
+        !BASIC_IN_PLACE,
+        [index](faulty_vector & v) { v.erase(index); },
+        [index, capacity](faulty_vector const & v) {
+          ASSERT_EQ(SIZE - 1, v.size());
+          EXPECT_EQ(capacity, v.capacity());
+          for (size_t i = 0; i < v.size(); ++i)
+          {
+            const size_t expected = (i < index ? i : i + 1);
+            EXPECT_EQ(static_cast<int>(expected), v[i].value);
+          }
+        });
+      EXPECT_EQ(index + 1 < SIZE, faults > 0);
+    }
+  }
+}
+
+TEST(Test_ywen_vector_fault_injection, test_growth)
+{
+  const size_t SIZE = 6;
+
+  const long push_faults = sweep_faults(
+    SIZE,
+    SIZE,
+    true,
+    [](faulty_vector & v) { v.push_back(faulty(42)); },
+    [](faulty_vector const & v) {
+      ASSERT_EQ(SIZE + 1, v.size());
+      EXPECT_EQ(42, v[SIZE].value);
+    });
+  // The allocation and the copies of the elements and the value.
+  EXPECT_EQ(static_cast<long>(SIZE + 2), push_faults);
+
+  // Growing beyond the capacity copies to a new buffer.
+  for (const size_t capacity : {SIZE, 2 * SIZE})
+  {
+    sweep_faults(
+      SIZE,
+      capacity,
+      true,
+      [](faulty_vector & v) { v.resize(3 * SIZE); },
+      [](faulty_vector const & v) {
+        ASSERT_EQ(3 * SIZE, v.size());
+        EXPECT_EQ(3 * SIZE, v.capacity());
+        EXPECT_EQ(static_cast<int>(SIZE - 1), v[SIZE - 1].value);
+        EXPECT_EQ(0, v[SIZE].value);
+      });
+  }
+
+  // Growing within the capacity assigns `_Ty()` to the new slots, which
+  // still hold the values of the popped elements.
+  const long in_place_faults = sweep_faults(
+    SIZE,
+    2 * SIZE,
+    true,
+    [](faulty_vector & v) { v.resize(2 * SIZE); },
+    [](faulty_vector const & v) {
+      ASSERT_EQ(2 * SIZE, v.size());
+      EXPECT_EQ(2 * SIZE, v.capacity());
+      for (size_t i = 0; i < v.size(); ++i)
+      {
+        EXPECT_EQ(i < SIZE ? static_cast<int>(i) : 0, v[i].value);
+      }
+    });
+  EXPECT_EQ(static_cast<long>(SIZE), in_place_faults);
+
+  // Nothing is left alive.
+  EXPECT_EQ(0, fault_injector::alive);
+  EXPECT_EQ(0, fault_injector::buffers);
+}
@@ -0,0 +1,281 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "../thread_pool/thread_pool.hpp"
+#include "vector.hpp"
+
+namespace ywen
+{
+
+// NOTE(ywen): The parallel algorithms run on a `thread_pool` and cut the
+// elements into pieces of at most `grain` elements (at least 1), which are
+// the units of work that the threads take and steal. A smaller grain
+// balances the load better, and a bigger grain costs less scheduling.
+//
+// When an element operation throws, the pieces that have not started are
+// skipped and the first exception is rethrown after the running pieces
+// return, like `thread_pool::parallel_for`. The vectors are always left
+// valid; which elements have changed is documented by each algorithm.
+
+/// The default number of elements of a piece of work.
+constexpr size_t DEFAULT_PARALLEL_GRAIN = 1U << 14;
+
+/// Call `fn(x)` for every element `x` of `v` in parallel.
+///
+/// Basic exception guarantee: if it throws, some elements may have been
+/// changed by `fn`.
+///
+/// Throws:
+/// - `std::bad_alloc`: When out of memory.
+/// - Exceptions thrown by `fn`.
+template<typename _Ty, typename _Storage, typename _Fn>
+void
+parallel_for_each(
+  thread_pool & pool,
+  vector<_Ty, _Storage> & v,
+  _Fn const & fn,
+  size_t grain = DEFAULT_PARALLEL_GRAIN)
+{
+  _Ty * const data = v.data();
+  pool.parallel_for(0, v.size(), grain, [data, &fn](size_t b, size_t e) {
+    for (size_t i = b; i < e; ++i)
+    {
+      fn(data[i]);
+    }
+  });
+}
+
+/// Replace the elements of `dst` with `fn(x)` for every element `x` of `src`,
+/// computed in parallel. `src` and `dst` may be the same vector.
+///
+/// Strong exception guarantee: if it throws, `dst` is not changed.
+///
+/// Throws:
+/// - `std::bad_alloc`: When out of memory.
+/// - Exceptions thrown by `fn`, and by `_Out`'s default constructor and copy
+///   assignment operator.
+template<
+  typename _Ty,
+  typename _Storage,
+  typename _Out,
+  typename _OutStorage,
+  typename _Fn>
+void
+parallel_transform(
+  thread_pool & pool,
+  vector<_Ty, _Storage> const & src,
+  vector<_Out, _OutStorage> & dst,
+  _Fn const & fn,
+  size_t grain = DEFAULT_PARALLEL_GRAIN)
+{
+  // The results are computed into a new vector, which replaces `dst` only
+  // when all of them have been computed.
+  vector<_Out, _OutStorage> tmp;
+  tmp.resize(src.size());
+
+  _Ty const * const in = src.data();
+  _Out * const out = tmp.data();
+  pool.parallel_for(0, src.size(), grain, [in, out, &fn](size_t b, size_t e) {
+    for (size_t i = b; i < e; ++i)
+    {
+      out[i] = fn(in[i]);
+    }
+  });
+
+  dst.swap(tmp);  // `swap()` doesn't throw.
+}
+
+/// Return `init` combined with all the elements of `v` by `op`, in parallel.
+///
+/// `op(acc, x)` must be associative and accept an element of `v` as well as
+/// a `_T` as `x`, but it needn't be commutative: the elements are combined
+/// in order. Every piece of `grain` elements is combined on its own,
+/// starting from its first element (converted to `_T`), and the results of
+/// the pieces are combined with `init` in order, so the result doesn't
+/// depend on the number of threads (even for floating-point numbers), only
+/// on `grain`.
+///
+/// Throws:
+/// - `std::bad_alloc`: When out of memory.
+/// - Exceptions thrown by `op`, and by `_T`'s constructors and assignment
+///   operators.
+template<typename _Ty, typename _Storage, typename _T, typename _BinaryOp>
+_T
+parallel_reduce(
+  thread_pool & pool,
+  vector<_Ty, _Storage> const & v,
+  _T init,
+  _BinaryOp const & op,
+  size_t grain = DEFAULT_PARALLEL_GRAIN)
+{
+  grain = (0 == grain ? 1 : grain);
+
+  const size_t n = v.size();
+  const size_t pieces = (n + grain - 1) / grain;
+  std::vector<_T> partials(pieces, init);
+
+  _Ty const * const data = v.data();
+  pool.parallel_for(0, pieces, 1, [&](size_t pb, size_t pe) {
+    for (size_t p = pb; p < pe; ++p)
+    {
+      const size_t b = p * grain;
+      const size_t e = std::min(n, b + grain);
+
+      _T acc = static_cast<_T>(data[b]);
+      for (size_t i = b + 1; i < e; ++i)
+      {
+        acc = op(std::move(acc), data[i]);
+      }
+      partials[p] = std::move(acc);
+    }
+  });
+
+  for (_T & partial : partials)
+  {
+    init = op(std::move(init), partial);
+  }
+
+  return init;
+}
+
+/// Merge the sorted ranges `[a, a_end)` and `[b, b_end)` into `out`, cutting
+/// the merge into pieces of at most `grain` elements that run on `group`.
+template<typename _Ty, typename _Compare>
+void
+_parallel_merge(
+  task_group & group,
+  _Ty const * a,
+  _Ty const * a_end,
+  _Ty const * b,
+  _Ty const * b_end,
+  _Ty * out,
+  _Compare const & comp,
+  size_t grain)
+{
+  // Split at the middle element of the longer range, which goes right to
+  // its place: the elements before it in both ranges are merged here, and
+  // the elements after it in another task.
+  while (static_cast<size_t>((a_end - a) + (b_end - b)) > grain)
+  {
+    if (a_end - a < b_end - b)
+    {
+      std::swap(a, b);
+      std::swap(a_end, b_end);
+    }
+
+    _Ty const * const a_mid = a + (a_end - a) / 2;
+    _Ty const * const b_mid = std::lower_bound(b, b_end, *a_mid, comp);
+    _Ty * const out_mid = out + (a_mid - a) + (b_mid - b);
+    *out_mid = *a_mid;
+
+    group.run([&group, a_mid, a_end, b_mid, b_end, out_mid, &comp, grain]() {
+      _parallel_merge(
+        group, a_mid + 1, a_end, b_mid, b_end, out_mid + 1, comp, grain);
+    });
+
+    a_end = a_mid;
+    b_end = b_mid;
+  }
+
+  if (!group.cancelled())
+  {
+    std::merge(a, a_end, b, b_end, out, comp);
+  }
+}
+
+/// Sort the elements of `v` by `comp` in parallel. The sort is not stable.
+///
+/// The elements are copied into a buffer in pieces, which are sorted in
+/// parallel, and the pieces are then merged pairwise between the buffer and
+/// a second one, each merge in parallel pieces of `grain` elements. It
+/// needs memory for twice the elements of `v`.
+///
+/// Strong exception guarantee: if it throws, `v` is not changed.
+///
+/// Throws:
+/// - `std::bad_alloc`: When out of memory.
+/// - Exceptions thrown by `comp`, and by _Ty's default constructor and copy
+///   assignment operator.
+template<
+  typename _Ty,
+  typename _Storage,
+  typename _Compare = std::less<_Ty>>
+void
+parallel_sort(
+  thread_pool & pool,
+  vector<_Ty, _Storage> & v,
+  _Compare const & comp = _Compare(),
+  size_t grain = DEFAULT_PARALLEL_GRAIN)
+{
+  grain = (0 == grain ? 1 : grain);
+
+  const size_t n = v.size();
+  if (n < 2)
+  {
+    return;
+  }
+
+  // Sort as many pieces as there are threads (rounded up to a power of 2),
+  // but no pieces smaller than the grain.
+  size_t pieces = 1;
+  while (pieces < pool.size() + 1)
+  {
+    pieces *= 2;
+  }
+  while (pieces > 1 && n / pieces < grain)
+  {
+    pieces /= 2;
+  }
+  const size_t width = (n + pieces - 1) / pieces;
+
+  vector<_Ty, _Storage> first;
+  vector<_Ty, _Storage> second;
+  first.resize(n);
+  second.resize(n);
+
+  _Ty const * const in = v.data();
+  _Ty * const sorted = first.data();
+  pool.parallel_for(0, pieces, 1, [&](size_t pb, size_t pe) {
+    for (size_t p = pb; p < pe; ++p)
+    {
+      const size_t b = std::min(n, p * width);
+      const size_t e = std::min(n, b + width);
+
+      std::copy(in + b, in + e, sorted + b);
+      std::sort(sorted + b, sorted + e, comp);
+    }
+  });
+
+  // Merge the sorted runs of `w` elements pairwise until one is left,
+  // swapping the roles of the two buffers after every pass.
+  vector<_Ty, _Storage> * src = &first;
+  vector<_Ty, _Storage> * dst = &second;
+  for (size_t w = width; w < n; w *= 2)
+  {
+    _Ty const * const s = src->data();
+    _Ty * const d = dst->data();
+
+    task_group group(pool);
+    for (size_t lo = 0; lo < n; lo += 2 * w)
+    {
+      const size_t mid = std::min(n, lo + w);
+      const size_t hi = std::min(n, lo + 2 * w);
+      group.run([&group, s, d, lo, mid, hi, &comp, grain]() {
+        _parallel_merge(
+          group, s + lo, s + mid, s + mid, s + hi, d + lo, comp, grain);
+      });
+    }
+    group.wait();
+
+    std::swap(src, dst);
+  }
+
+  v.swap(*src);  // `swap()` doesn't throw.
+}
+
+}  // namespace ywen
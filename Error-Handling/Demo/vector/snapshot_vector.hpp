@@ -0,0 +1,331 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "vector.hpp"
+
+namespace ywen
+{
+
+// NOTE(ywen): How a reader gets a snapshot without locks or retries.
+//
+// The versions are kept in a table of `MAX_VERSIONS` slots, and the current
+// version is published as one 64-bit word: the slot index in the high 16
+// bits and the number of times the version has been acquired in the low 48
+// bits. A reader acquires the current version with a single `fetch_add(1)`
+// on the word, which tells it the slot and counts it at the same time, so
+// there is no window in which the version can be reclaimed under it. When
+// the reader is done, it increments the version's `released` counter.
+//
+// The writer publishes a new version by exchanging the word, which returns
+// the final acquisition count of the old version. The old version is
+// retired, and it's reclaimed (by the writer, on a later update) when its
+// `released` counter reaches that count. The readers never free memory, so
+// they never pay for deleting a big version.
+
+/// A vector that many readers read through immutable snapshots while
+/// writers publish new versions of it.
+///
+/// `load()` is wait-free: it never blocks and never retries, whatever the
+/// writers do. A snapshot keeps its version alive (and unchanged) until it's
+/// destroyed. A writer copies the current version, changes the copy with
+/// the usual `vector` operations (e.g., `insert` and `erase`, in a batch),
+/// and publishes it atomically; the writers are serialized by a mutex.
+template<typename _Ty>
+class snapshot_vector
+{
+private:
+  struct _version
+  {
+    vector<_Ty> elements;
+
+    /// The number of snapshots of this version that have been destroyed. It's
+    /// on its own cache line, so the readers that release their snapshots
+    /// don't invalidate the line of `elements`, which every reader loads.
+    alignas(64) std::atomic<uint64_t> released{0};
+  };
+
+public:
+  /// The maximum number of versions that are alive at the same time: the
+  /// current one, and the retired ones that snapshots still refer to.
+  static constexpr size_t MAX_VERSIONS = 1024;
+
+  /// A read-only reference to a version, which must be destroyed before
+  /// the `snapshot_vector`.
+  class snapshot
+  {
+  public:
+    snapshot(snapshot && other) noexcept : m_version(other.m_version)
+    {
+      other.m_version = nullptr;
+    }
+
+    snapshot &
+    operator=(snapshot && other) noexcept
+    {
+      std::swap(m_version, other.m_version);
+      return *this;
+    }
+
+    snapshot(snapshot const &) = delete;
+
+    snapshot &
+    operator=(snapshot const &) = delete;
+
+    ~snapshot() noexcept
+    {
+      if (m_version != nullptr)
+      {
+        m_version->released.fetch_add(1, std::memory_order_release);
+      }
+    }
+
+    vector<_Ty> const &
+    operator*() const noexcept
+    {
+      return m_version->elements;
+    }
+
+    vector<_Ty> const *
+    operator->() const noexcept
+    {
+      return &m_version->elements;
+    }
+
+    size_t
+    size() const noexcept
+    {
+      return m_version->elements.size();
+    }
+
+    _Ty const &
+    operator[](const size_t i) const noexcept
+    {
+      return m_version->elements[i];
+    }
+
+  private:
+    friend class snapshot_vector;
+
+    explicit snapshot(_version * version) noexcept : m_version(version)
+    {
+      // Empty
+    }
+
+    _version * m_version;
+  };
+
+  /// Construct an empty vector.
+  ///
+  /// Throws:
+  /// - `std::bad_alloc`: When out of memory.
+  snapshot_vector();
+
+  snapshot_vector(snapshot_vector const &) = delete;
+
+  snapshot_vector &
+  operator=(snapshot_vector const &) = delete;
+
+  /// Delete all the versions. All the snapshots must have been destroyed.
+  ~snapshot_vector() noexcept;
+
+  /// Return a snapshot of the current version. Wait-free.
+  snapshot
+  load() const noexcept;
+
+  /// Copy the current version, call `fn(v)` with the copy `v`, and publish
+  /// `v` as the new current version. Then reclaim the retired versions that
+  /// are no longer referred to.
+  ///
+  /// If `MAX_VERSIONS` versions are alive, it waits until a snapshot of a
+  /// retired version is destroyed (so it must not be called by a thread
+  /// that holds such a snapshot in that case).
+  ///
+  /// Strong exception guarantee: if it throws, no version is published.
+  ///
+  /// Throws:
+  /// - `std::bad_alloc`: When out of memory.
+  /// - Exceptions thrown by `fn`, and by _Ty's default constructor and copy
+  ///   assignment operator.
+  template<typename _Fn>
+  void
+  update(_Fn && fn);
+
+  /// Reclaim the retired versions that are no longer referred to. Returns
+  /// the number of retired versions that are still alive.
+  size_t
+  reclaim() noexcept;
+
+private:
+  static constexpr int INDEX_SHIFT = 48;
+  static constexpr uint64_t COUNT_MASK = (uint64_t(1) << INDEX_SHIFT) - 1;
+
+  /// Reclaim the retired versions that are no longer referred to. The
+  /// writer mutex must be held.
+  void
+  _reclaim() noexcept;
+
+  /// Take a free slot, waiting for one if needed. The writer mutex must be
+  /// held.
+  size_t
+  _take_slot() noexcept;
+
+private:
+  /// The slot index and the acquisition count of the current version.
+  alignas(64) mutable std::atomic<uint64_t> m_current;
+
+  /// The versions by slot. A slot is written only when it's free.
+  std::unique_ptr<std::atomic<_version *>[]> m_table;
+
+  /// The writer state, guarded by `m_mutex`.
+  alignas(64) std::mutex m_mutex;
+  std::vector<size_t> m_free_slots;
+
+  /// The retired versions' slots and their final acquisition counts.
+  std::vector<std::pair<size_t, uint64_t>> m_retired;
+};
+
+template<class _Ty>
+snapshot_vector<_Ty>::snapshot_vector()
+  : m_current(0), m_table(new std::atomic<_version *>[MAX_VERSIONS])
+{
+  m_free_slots.reserve(MAX_VERSIONS);
+  m_retired.reserve(MAX_VERSIONS);
+  for (size_t i = MAX_VERSIONS; i > 1; --i)
+  {
+    m_table[i - 1].store(nullptr, std::memory_order_relaxed);
+    m_free_slots.push_back(i - 1);
+  }
+
+  // The initial empty version is in slot 0.
+  m_table[0].store(new _version(), std::memory_order_relaxed);
+}
+
+template<class _Ty>
+snapshot_vector<_Ty>::~snapshot_vector() noexcept
+{
+  for (size_t i = 0; i < MAX_VERSIONS; ++i)
+  {
+    delete m_table[i].load(std::memory_order_relaxed);
+  }
+}
+
+template<class _Ty>
+typename snapshot_vector<_Ty>::snapshot
+snapshot_vector<_Ty>::load() const noexcept
+{
+  // The acquire pairs with the release of the exchange in `update`, so the
+  // table entry and the elements of the version are visible.
+  const uint64_t word = m_current.fetch_add(1, std::memory_order_acquire);
+  assert(((word & COUNT_MASK) != COUNT_MASK));
+
+  return snapshot(
+    m_table[word >> INDEX_SHIFT].load(std::memory_order_relaxed));
+}
+
+template<class _Ty>
+template<typename _Fn>
+void
+snapshot_vector<_Ty>::update(_Fn && fn)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  // Only the writer changes the slot of the current version, so it can be
+  // read without acquiring the version.
+  const size_t current_slot = static_cast<size_t>(
+    m_current.load(std::memory_order_relaxed) >> INDEX_SHIFT);
+  vector<_Ty> const & current =
+    m_table[current_slot].load(std::memory_order_relaxed)->elements;
+
+  // Copy the current version. `new` and `resize` may throw `std::bad_alloc`,
+  // and _Ty's copy assignment may throw, in which case `next` is freed.
+  std::unique_ptr<_version> next(new _version());
+  next->elements.resize(current.size());
+  for (size_t i = 0; i < current.size(); ++i)
+  {
+    next->elements[i] = current[i];
+  }
+
+  // `fn` may throw, in which case `next` is freed.
+  fn(next->elements);
+
+  // `_take_slot()` doesn't throw: it only pops a slot that was reserved up
+  // front, but it may block until a retired version is reclaimed.
+  const size_t slot = this->_take_slot();
+  m_table[slot].store(next.release(), std::memory_order_relaxed);
+
+  // Publish the new version. The release makes the elements visible to the
+  // readers that acquire it.
+  const uint64_t old = m_current.exchange(
+    static_cast<uint64_t>(slot) << INDEX_SHIFT, std::memory_order_acq_rel);
+  assert(((old >> INDEX_SHIFT) == current_slot));
+
+  // `m_retired` has room for all the slots, so it doesn't throw.
+  m_retired.emplace_back(current_slot, old & COUNT_MASK);
+
+  this->_reclaim();
+}
+
+template<class _Ty>
+size_t
+snapshot_vector<_Ty>::reclaim() noexcept
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  this->_reclaim();
+  return m_retired.size();
+}
+
+template<class _Ty>
+void
+snapshot_vector<_Ty>::_reclaim() noexcept
+{
+  size_t kept = 0;
+  for (size_t i = 0; i < m_retired.size(); ++i)
+  {
+    const size_t slot = m_retired[i].first;
+    _version * v = m_table[slot].load(std::memory_order_relaxed);
+
+    // The acquire pairs with the release in `~snapshot`, so the readers are
+    // done with the version before it's deleted.
+    if (v->released.load(std::memory_order_acquire) == m_retired[i].second)
+    {
+      delete v;
+      m_table[slot].store(nullptr, std::memory_order_relaxed);
+
+      // `m_free_slots` has room for all the slots, so it doesn't throw.
+      m_free_slots.push_back(slot);
+    }
+    else
+    {
+      m_retired[kept++] = m_retired[i];
+    }
+  }
+  m_retired.resize(kept);
+}
+
+template<class _Ty>
+size_t
+snapshot_vector<_Ty>::_take_slot() noexcept
+{
+  while (m_free_slots.empty())
+  {
+    this->_reclaim();
+    if (m_free_slots.empty())
+    {
+      std::this_thread::yield();
+    }
+  }
+
+  const size_t slot = m_free_slots.back();
+  m_free_slots.pop_back();
+  return slot;
+}
+
+}  // namespace ywen
@@ -2,13 +2,40 @@
 
 #include <cassert>
 #include <cstddef>
+#include <functional>
 #include <initializer_list>
 #include <memory>
+#include <type_traits>
 #include <utility>
 
 namespace ywen
 {
 
+/// The default storage of `vector`, which allocates the elements with `new[]`
+/// and frees them with `delete[]`.
+///
+/// A storage policy provides `allocate(count)`, which returns `count` (at
+/// least 1) default-initialized elements, and `deallocate(p, count)`, which
+/// destroys and frees them (`p` is never `nullptr`).
+template<typename _Ty>
+struct new_storage
+{
+  /// Throws:
+  /// - `std::bad_alloc`: When out of memory.
+  /// - Exceptions thrown by _Ty's default constructor.
+  static _Ty *
+  allocate(const size_t count)
+  {
+    return new _Ty[count];
+  }
+
+  static void
+  deallocate(_Ty * p, const size_t /* count */) noexcept
+  {
+    delete[] p;
+  }
+};
+
 /// A simple vector implementation. This vector does not try to implement the
 /// standard C++ vector behavior (so some member functions do not match the
 /// signatures of the standard vector). Instead, this vector is mainly for
@@ -16,10 +43,17 @@ namespace ywen
 ///
 /// Some outstanding differences than the standard C++ vector:
 /// - No iterator.
-/// - No allocator.
+/// - No allocator, but a storage policy (see `new_storage`).
 /// - Some member functions (e.g., `at`) do not throw exceptions.
 /// - Prefer exception safety over complexity.
-template<typename _Ty>
+///
+/// All the member functions that change the vector give the strong exception
+/// guarantee, which `insert` and `erase` pay for by copying all the elements
+/// to a new buffer every time. If `YWEN_VECTOR_BASIC_GUARANTEE` is defined,
+/// they move the elements in place instead when the buffer doesn't have to
+/// grow, and only give the basic guarantee in that case: if they throw, the
+/// vector is valid and leaks nothing, but its elements are unspecified.
+template<typename _Ty, typename _Storage = new_storage<_Ty>>
 class vector
 {
 public:
@@ -51,22 +85,50 @@ public:
 
   /// Insert the given value at the specified location.
   ///
+  /// Strong exception guarantee: if it throws, the vector is not changed
+  /// (but see `YWEN_VECTOR_BASIC_GUARANTEE` above).
+  ///
   /// Throws:
   /// - `std::bad_alloc`: When out of memory.
-  /// - Exceptions thrown by _Ty's copy assignment operator. This `vector` does
-  ///   not catch them so the `vector` users must deal with them.
+  /// - Exceptions thrown by _Ty's copy (and, in place, move) assignment
+  ///   operator. This `vector` does not catch them so the `vector` users must
+  ///   deal with them.
   constexpr void
   insert(const size_t index, _Ty const & value);
 
   /// Erase the value at the specified location.
   ///
+  /// Strong exception guarantee: if it throws, the vector is not changed
+  /// (but see `YWEN_VECTOR_BASIC_GUARANTEE` above).
+  ///
   /// Throws:
   /// - `std::bad_alloc`: When out of memory.
-  /// - Exceptions thrown by _Ty's copy assignment operator. This `vector` does
-  ///   not catch them so the `vector` users must deal with them.
+  /// - Exceptions thrown by _Ty's copy (and, in place, move) assignment
+  ///   operator. This `vector` does not catch them so the `vector` users must
+  ///   deal with them.
   constexpr void
   erase(const size_t index);
 
+  /// Change the number of elements to `count`. The elements beyond `count`
+  /// are removed, and the new elements are default-initialized: they are
+  /// left indeterminate if _Ty is trivially default-constructible (so they
+  /// can be filled, e.g., by reading a file, without clearing them first),
+  /// and are assigned `_Ty()` otherwise.
+  ///
+  /// Strong exception guarantee: if it throws, the vector is not changed.
+  ///
+  /// Throws:
+  /// - `std::bad_alloc`: When out of memory.
+  /// - Exceptions thrown by _Ty's default constructor and copy assignment
+  ///   operator. This `vector` does not catch them so the `vector` users must
+  ///   deal with them.
+  constexpr void
+  resize(const size_t count);
+
+  /// Exchange the elements (and the capacities) of this vector and `other`.
+  constexpr void
+  swap(vector & other) noexcept;
+
   /// Get vector's size.
   constexpr size_t
   size() const noexcept;
@@ -106,23 +168,52 @@ public:
   data() const noexcept;
 
 private:
+  /// Free a buffer of `count` elements of `_Storage`, for `std::unique_ptr`.
+  struct _deleter
+  {
+    size_t count;
+
+    void
+    operator()(_Ty * p) const noexcept
+    {
+      _Storage::deallocate(p, count);
+    }
+  };
+
+  /// A buffer that is freed unless it's released.
+  using _buffer = std::unique_ptr<_Ty[], _deleter>;
+
   /// Return the new capacity based on the given capacity.
   static size_t
   _get_new_capacity(const size_t capacity) noexcept;
 
+  /// Insert `value` at `index` by moving the elements after it one slot to
+  /// the right. The buffer must have a free slot.
+  ///
+  /// Basic exception guarantee.
+  constexpr void
+  _insert_in_place(const size_t index, _Ty const & value);
+
+  /// Erase the element at `index` by moving the elements after it one slot
+  /// to the left.
+  ///
+  /// Basic exception guarantee.
+  constexpr void
+  _erase_in_place(const size_t index);
+
 private:
   /// The current number of elements inside the vector.
   ///
   /// Invariants:
   /// - `m_size <= m_capacity`.
-  unsigned int m_size;
+  size_t m_size;
 
   /// The number of total slots that the vector can use to store elements
   /// having to allocate more slots.
   ///
   /// Invariants:
   /// - `m_size <= m_capacity`
-  unsigned int m_capacity;
+  size_t m_capacity;
 
   /// The raw pointer to the underlying memory storage.
   ///
@@ -132,15 +223,16 @@ private:
   _Ty * m_vec;
 };
 
-template<class _Ty>
-constexpr vector<_Ty>::vector() noexcept
+template<class _Ty, class _Storage>
+constexpr vector<_Ty, _Storage>::vector() noexcept
   : m_size(0), m_capacity(0), m_vec(nullptr)
 {
   // Empty
 }
 
-template<class _Ty>
-constexpr vector<_Ty>::vector(std::initializer_list<_Ty> init)
+template<class _Ty, class _Storage>
+constexpr vector<_Ty, _Storage>::vector(std::initializer_list<_Ty> init)
+  : m_size(0), m_capacity(0), m_vec(nullptr)
 {
   const size_t count = init.size();  // `size()` does not throw.
 
@@ -153,8 +245,8 @@ constexpr vector<_Ty>::vector(std::initializer_list<_Ty> init)
     return;
   }
 
-  // `new` may throw `std::bad_alloc`
-  std::unique_ptr<_Ty[]> new_vec(new _Ty[count]);
+  // `allocate` may throw `std::bad_alloc`
+  _buffer new_vec(_Storage::allocate(count), _deleter{count});
 
   size_t i = 0;
   for (typename std::initializer_list<_Ty>::iterator it = init.begin();
@@ -177,8 +269,8 @@ constexpr vector<_Ty>::vector(std::initializer_list<_Ty> init)
   assert((count == m_capacity));
 }
 
-template<class _Ty>
-vector<_Ty>::~vector() noexcept
+template<class _Ty, class _Storage>
+vector<_Ty, _Storage>::~vector() noexcept
 {
   // NOTE(ywen): Ideally, _Ty's destructor should not throw. In reality, it
   // may throw. Because this is library code, we want to propagate the
@@ -186,7 +278,7 @@ vector<_Ty>::~vector() noexcept
   // exception and handle it, but it's up to them.
   if (m_vec != nullptr)
   {
-    delete[] m_vec;
+    _Storage::deallocate(m_vec, m_capacity);
     m_vec = nullptr;
   }
 
@@ -198,27 +290,35 @@ vector<_Ty>::~vector() noexcept
   assert((0 == m_capacity));
 }
 
-template<class _Ty>
+template<class _Ty, class _Storage>
 constexpr void
-vector<_Ty>::push_back(_Ty const & value)
+vector<_Ty, _Storage>::push_back(_Ty const & value)
 {
   this->insert(m_size, value);
 }
 
-template<class _Ty>
+template<class _Ty, class _Storage>
 constexpr void
-vector<_Ty>::pop_back()
+vector<_Ty, _Storage>::pop_back()
 {
   this->erase(m_size - 1);
 }
 
-template<class _Ty>
+template<class _Ty, class _Storage>
 constexpr void
-vector<_Ty>::insert(const size_t index, _Ty const & value)
+vector<_Ty, _Storage>::insert(const size_t index, _Ty const & value)
 {
   assert((0U <= index));
   assert((index <= m_size));
 
+#ifdef YWEN_VECTOR_BASIC_GUARANTEE
+  if (m_size < m_capacity)
+  {
+    this->_insert_in_place(index, value);
+    return;
+  }
+#endif
+
   const size_t prev_size = m_size;
   const size_t prev_capacity = m_capacity;
 
@@ -226,8 +326,8 @@ vector<_Ty>::insert(const size_t index, _Ty const & value)
     (m_size + 1 > m_capacity ? _get_new_capacity(m_capacity) : m_capacity);
   const size_t new_size = m_size + 1;
 
-  // `new` may throw `std::bad_alloc`.
-  std::unique_ptr<_Ty[]> new_vec(new _Ty[m_capacity]);
+  // `allocate` may throw `std::bad_alloc`.
+  _buffer new_vec(_Storage::allocate(new_capacity), _deleter{new_capacity});
 
   // Copy the first half (i.e., before the position that `index` points at) to
   // the same location in the new vector.
@@ -260,8 +360,12 @@ vector<_Ty>::insert(const size_t index, _Ty const & value)
   // Ideally, deleting the array should not throw. If it throws because the
   // destructor throws, we can't handle it gracefully and have to terminate
   // anyway. Should that happen, we still wouldn't have resource leak and the
-  // size and capacity would still be correct.
-  delete[] tmp_vec;
+  // size and capacity would still be correct. The vector may have had no
+  // buffer.
+  if (tmp_vec != nullptr)
+  {
+    _Storage::deallocate(tmp_vec, prev_capacity);
+  }
 
   // Set capacity before size to make sure capacity is always >= size, which
   // is a valid state. (In contrast, capacity < size is an invalid state.)
@@ -274,14 +378,19 @@ vector<_Ty>::insert(const size_t index, _Ty const & value)
   assert((prev_capacity <= m_capacity));
 }
 
-template<class _Ty>
+template<class _Ty, class _Storage>
 constexpr void
-vector<_Ty>::erase(const size_t index)
+vector<_Ty, _Storage>::erase(const size_t index)
 {
   assert(0U < m_size);
   assert((0U <= index));
   assert((index < m_size));
 
+#ifdef YWEN_VECTOR_BASIC_GUARANTEE
+  this->_erase_in_place(index);
+  return;
+#endif
+
   const size_t prev_size = m_size;
   const size_t prev_capacity = m_capacity;
   const size_t new_size = m_size - 1;
@@ -296,8 +405,8 @@ vector<_Ty>::erase(const size_t index)
     // Erase at the head or in the middle, then we need to do more.
 
     // When we erase an element, we can keep using the existing capacity.
-    // `new` may throw `std::bad_alloc`.
-    std::unique_ptr<_Ty[]> new_vec(new _Ty[m_capacity]);
+    // `allocate` may throw `std::bad_alloc`.
+    _buffer new_vec(_Storage::allocate(m_capacity), _deleter{m_capacity});
 
     // Copy the first half (i.e., before the position that `index` points at)
     // to the same location in the new vector.
@@ -324,7 +433,7 @@ vector<_Ty>::erase(const size_t index)
     // destructor throws, we can't handle it gracefully and have to terminate
     // anyway. Should that happen, we still wouldn't have resource leak and the
     // size and capacity would still be correct.
-    delete[] tmp_vec;
+    _Storage::deallocate(tmp_vec, m_capacity);
   }
 
   m_size = new_size;
@@ -334,37 +443,103 @@ vector<_Ty>::erase(const size_t index)
   assert((m_capacity == prev_capacity));
 }
 
-template<class _Ty>
+template<class _Ty, class _Storage>
+constexpr void
+vector<_Ty, _Storage>::resize(const size_t count)
+{
+  const size_t prev_size = m_size;
+  const size_t prev_capacity = m_capacity;
+
+  if (count <= m_capacity)
+  {
+    // The slots up to the capacity have been constructed by `new`, but the
+    // ones beyond the size may hold the values of the erased elements.
+    if (!std::is_trivially_default_constructible<_Ty>::value)
+    {
+      for (size_t i = m_size; i < count; ++i)
+      {
+        // If _Ty's default constructor or copy assignment throws, only the
+        // slots beyond the size have been changed, which are not observable.
+        m_vec[i] = _Ty();
+      }
+    }
+
+    m_size = count;
+
+    assert((m_size <= m_capacity));
+    assert((prev_capacity == m_capacity));
+    return;
+  }
+
+  // `allocate` may throw `std::bad_alloc`. It default-initializes the
+  // elements.
+  _buffer new_vec(_Storage::allocate(count), _deleter{count});
+
+  for (size_t i = 0; i < m_size; ++i)
+  {
+    // If _Ty's copy assignment throws, `new_vec` will de-allocate the
+    // temporary vector so no resource leaks.
+    new_vec[i] = m_vec[i];
+  }
+
+  _Ty * tmp_vec = new_vec.release();  // `release()` doesn't throw.
+  std::swap(tmp_vec, m_vec);          // `std::swap()` doesn't throw.
+
+  // See `insert` about the destructor throwing.
+  if (tmp_vec != nullptr)
+  {
+    _Storage::deallocate(tmp_vec, prev_capacity);
+  }
+
+  // Set capacity before size to make sure capacity is always >= size.
+  m_capacity = count;
+  m_size = count;
+
+  assert((nullptr != m_vec));
+  assert((prev_size < m_size));
+  assert((prev_capacity < m_capacity));
+}
+
+template<class _Ty, class _Storage>
+constexpr void
+vector<_Ty, _Storage>::swap(vector & other) noexcept
+{
+  std::swap(m_size, other.m_size);
+  std::swap(m_capacity, other.m_capacity);
+  std::swap(m_vec, other.m_vec);
+}
+
+template<class _Ty, class _Storage>
 constexpr size_t
-vector<_Ty>::size() const noexcept
+vector<_Ty, _Storage>::size() const noexcept
 {
   return m_size;
 }
 
-template<class _Ty>
+template<class _Ty, class _Storage>
 constexpr size_t
-vector<_Ty>::capacity() const noexcept
+vector<_Ty, _Storage>::capacity() const noexcept
 {
   return m_capacity;
 }
 
-template<class _Ty>
+template<class _Ty, class _Storage>
 constexpr bool
-vector<_Ty>::empty() const noexcept
+vector<_Ty, _Storage>::empty() const noexcept
 {
   return 0 == m_size;
 }
 
-template<class _Ty>
+template<class _Ty, class _Storage>
 constexpr _Ty &
-vector<_Ty>::at(const size_t i) noexcept
+vector<_Ty, _Storage>::at(const size_t i) noexcept
 {
-  return const_cast<_Ty &>(static_cast<vector<_Ty> const *>(this)->at(i));
+  return const_cast<_Ty &>(static_cast<vector const *>(this)->at(i));
 }
 
-template<class _Ty>
+template<class _Ty, class _Storage>
 constexpr _Ty const &
-vector<_Ty>::at(const size_t i) const noexcept
+vector<_Ty, _Storage>::at(const size_t i) const noexcept
 {
   assert((0 <= i));
   assert((i < m_size));
@@ -372,37 +547,83 @@ vector<_Ty>::at(const size_t i) const noexcept
   return m_vec[i];
 }
 
-template<class _Ty>
+template<class _Ty, class _Storage>
 constexpr _Ty &
-vector<_Ty>::operator[](const size_t i) noexcept
+vector<_Ty, _Storage>::operator[](const size_t i) noexcept
 {
   return this->at(i);
 }
 
-template<class _Ty>
+template<class _Ty, class _Storage>
 constexpr _Ty const &
-vector<_Ty>::operator[](const size_t i) const noexcept
+vector<_Ty, _Storage>::operator[](const size_t i) const noexcept
 {
   return this->at(i);
 }
 
-template<class _Ty>
+template<class _Ty, class _Storage>
 constexpr _Ty *
-vector<_Ty>::data() noexcept
+vector<_Ty, _Storage>::data() noexcept
 {
   return m_vec;
 }
 
-template<class _Ty>
+template<class _Ty, class _Storage>
 constexpr const _Ty *
-vector<_Ty>::data() const noexcept
+vector<_Ty, _Storage>::data() const noexcept
 {
   return m_vec;
 }
 
-template<class _Ty>
+template<class _Ty, class _Storage>
+constexpr void
+vector<_Ty, _Storage>::_insert_in_place(const size_t index, _Ty const & value)
+{
+  assert((index <= m_size));
+  assert((m_size < m_capacity));
+
+  // `value` may be one of the elements that are moved below, in which case
+  // it's copied from the slot it's moved to.
+  _Ty const * src = std::addressof(value);
+  std::less<_Ty const *> less;
+  if (!less(src, m_vec + index) && less(src, m_vec + m_size))
+  {
+    ++src;
+  }
+
+  // If _Ty's move or copy assignment throws, the size is not changed, but
+  // the elements may have been moved (and the last one duplicated).
+  for (size_t i = m_size; i > index; --i)
+  {
+    m_vec[i] = std::move(m_vec[i - 1]);
+  }
+  m_vec[index] = *src;
+
+  ++m_size;
+
+  assert((m_size <= m_capacity));
+}
+
+template<class _Ty, class _Storage>
+constexpr void
+vector<_Ty, _Storage>::_erase_in_place(const size_t index)
+{
+  assert((index < m_size));
+
+  // If _Ty's move assignment throws, the size is not changed, but the
+  // elements may have been moved. The slot beyond the size is left
+  // moved-from (see `resize`).
+  for (size_t i = index; i + 1 < m_size; ++i)
+  {
+    m_vec[i] = std::move(m_vec[i + 1]);
+  }
+
+  --m_size;
+}
+
+template<class _Ty, class _Storage>
 size_t
-vector<_Ty>::_get_new_capacity(const size_t capacity) noexcept
+vector<_Ty, _Storage>::_get_new_capacity(const size_t capacity) noexcept
 {
   return static_cast<size_t>(capacity * 2 + 1);
 }
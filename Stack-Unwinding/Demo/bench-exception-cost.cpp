@@ -0,0 +1,304 @@
+// Measure the cost of throwing and catching exceptions.
+//
+// This is a Google Benchmark program, so its results can be written in a
+// machine-readable format, e.g.:
+//
+//   bench_exception_cost --benchmark_format=json
+//   bench_exception_cost --benchmark_out=result.csv --benchmark_out_format=csv
+//
+// Every benchmark also runs on 1 to N threads (N = the number of CPUs) so the
+// contention in the unwinder (e.g., the lock around the lookup of the unwind
+// tables) shows up as a throughput that does not scale with the threads.
+//
+// The same benchmarks are also built as `bench_exception_cost_pooled`, which
+// links `exception_pool`, to compare the pool with the runtime's allocator.
+#include <benchmark/benchmark.h>
+
+#include <cxxabi.h>
+
+#include <array>
+#include <cstring>
+#include <thread>
+
+#define NOINLINE __attribute__((noinline))
+
+namespace
+{
+
+// The exception type, like `MyExcept` in the demos, but with a payload whose
+// copy cost is what catch-by-value pays.
+class MyExcept
+{
+public:
+  MyExcept(int code) noexcept : _code(code)
+  {
+    std::memset(_payload, code, sizeof(_payload));
+  }
+
+  MyExcept(MyExcept const &other) noexcept : _code(other._code)
+  {
+    std::memcpy(_payload, other._payload, sizeof(_payload));
+    benchmark::ClobberMemory();
+  }
+
+  int code() const noexcept
+  {
+    return _code;
+  }
+
+private:
+  int _code;
+  char _payload[256];
+};
+
+// The object with a non-trivial destructor, like `A` in the demos, that the
+// unwinder has to destroy in each frame.
+class A
+{
+public:
+  A() noexcept
+  {
+    benchmark::ClobberMemory();
+  }
+
+  A(A const &) = delete;
+  A &operator=(A const &) = delete;
+
+  ~A() noexcept
+  {
+    benchmark::ClobberMemory();
+  }
+};
+
+// An expected-style return value.
+struct Result
+{
+  int value;
+  int error;
+};
+
+// The number of threads each benchmark runs on.
+int max_threads()
+{
+  const unsigned n = std::thread::hardware_concurrency();
+  return (0 == n ? 1 : static_cast<int>(n));
+}
+
+// Recurse `depth` frames with `N` objects of `A` in each frame, then throw.
+template <int N>
+NOINLINE int throw_at_depth(int depth)
+{
+  std::array<A, N> objects;
+  benchmark::DoNotOptimize(objects.data());
+
+  if (0 == depth)
+  {
+    throw MyExcept(depth);
+  }
+
+  // Adding 1 keeps the call from being a tail call, so each level is a real
+  // frame that the unwinder walks through.
+  return throw_at_depth<N>(depth - 1) + 1;
+}
+
+// Recurse `depth` frames, then fail with an error code that every frame has
+// to check and pass on.
+NOINLINE int error_code_at_depth(int depth, int *value)
+{
+  if (0 == depth)
+  {
+    return -1;
+  }
+
+  int ret = error_code_at_depth(depth - 1, value);
+  if (ret != 0)
+  {
+    return ret;
+  }
+
+  *value += 1;
+  return 0;
+}
+
+// Recurse `depth` frames, then fail with an expected-style return value that
+// every frame has to check and pass on.
+NOINLINE Result expected_at_depth(int depth)
+{
+  if (0 == depth)
+  {
+    return Result{0, -1};
+  }
+
+  Result r = expected_at_depth(depth - 1);
+  if (r.error != 0)
+  {
+    return r;
+  }
+
+  return Result{r.value + 1, 0};
+}
+
+// Throw-to-catch latency against the unwind depth.
+//
+// Arguments:
+// - 0: The number of frames between the `throw` and the `catch`.
+void BM_throw_depth(benchmark::State &state)
+{
+  const int depth = static_cast<int>(state.range(0));
+
+  for (auto _ : state)
+  {
+    try
+    {
+      benchmark::DoNotOptimize(throw_at_depth<0>(depth));
+    }
+    catch (MyExcept const &e)
+    {
+      benchmark::DoNotOptimize(e.code());
+    }
+  }
+}
+
+// Throw-to-catch latency against the number of objects with non-trivial
+// destructors in each of the 8 frames.
+template <int N>
+void BM_throw_destructors(benchmark::State &state)
+{
+  for (auto _ : state)
+  {
+    try
+    {
+      benchmark::DoNotOptimize(throw_at_depth<N>(8));
+    }
+    catch (MyExcept const &e)
+    {
+      benchmark::DoNotOptimize(e.code());
+    }
+  }
+}
+
+// Catch by value, which copies the exception object.
+void BM_catch_by_value(benchmark::State &state)
+{
+  for (auto _ : state)
+  {
+    try
+    {
+      benchmark::DoNotOptimize(throw_at_depth<0>(1));
+    }
+    catch (MyExcept e)
+    {
+      benchmark::DoNotOptimize(e.code());
+    }
+  }
+}
+
+// Catch by reference, which does not copy the exception object.
+void BM_catch_by_reference(benchmark::State &state)
+{
+  for (auto _ : state)
+  {
+    try
+    {
+      benchmark::DoNotOptimize(throw_at_depth<0>(1));
+    }
+    catch (MyExcept const &e)
+    {
+      benchmark::DoNotOptimize(e.code());
+    }
+  }
+}
+
+// Report a failure through `depth` frames with an error code.
+//
+// Arguments:
+// - 0: The number of frames between the failure and the handler.
+void BM_error_code(benchmark::State &state)
+{
+  const int depth = static_cast<int>(state.range(0));
+
+  for (auto _ : state)
+  {
+    int value = 0;
+    benchmark::DoNotOptimize(error_code_at_depth(depth, &value));
+    benchmark::DoNotOptimize(value);
+  }
+}
+
+// Report a failure through `depth` frames with an expected-style value.
+//
+// Arguments:
+// - 0: The number of frames between the failure and the handler.
+void BM_expected(benchmark::State &state)
+{
+  const int depth = static_cast<int>(state.range(0));
+
+  for (auto _ : state)
+  {
+    Result r = expected_at_depth(depth);
+    benchmark::DoNotOptimize(r);
+  }
+}
+
+// Allocate and free an exception object without throwing it, to isolate the
+// cost of the allocator.
+//
+// Arguments:
+// - 0: The size of the exception object.
+void BM_allocate_exception(benchmark::State &state)
+{
+  const std::size_t size = static_cast<std::size_t>(state.range(0));
+
+  for (auto _ : state)
+  {
+    void *obj = __cxxabiv1::__cxa_allocate_exception(size);
+    benchmark::DoNotOptimize(obj);
+    __cxxabiv1::__cxa_free_exception(obj);
+  }
+}
+
+} // namespace
+
+BENCHMARK(BM_allocate_exception)
+    ->Arg(16)
+    ->Arg(256)
+    ->Arg(4096)
+    ->ArgName("size")
+    ->ThreadRange(1, max_threads())
+    ->UseRealTime();
+
+BENCHMARK(BM_throw_depth)
+    ->RangeMultiplier(4)
+    ->Range(1, 256)
+    ->ArgName("depth")
+    ->ThreadRange(1, max_threads())
+    ->UseRealTime();
+
+BENCHMARK_TEMPLATE(BM_throw_destructors, 0)
+    ->ThreadRange(1, max_threads())
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_throw_destructors, 1)
+    ->ThreadRange(1, max_threads())
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_throw_destructors, 4)
+    ->ThreadRange(1, max_threads())
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_throw_destructors, 16)
+    ->ThreadRange(1, max_threads())
+    ->UseRealTime();
+
+BENCHMARK(BM_catch_by_value)->ThreadRange(1, max_threads())->UseRealTime();
+BENCHMARK(BM_catch_by_reference)->ThreadRange(1, max_threads())->UseRealTime();
+
+BENCHMARK(BM_error_code)
+    ->RangeMultiplier(4)
+    ->Range(1, 256)
+    ->ArgName("depth")
+    ->ThreadRange(1, max_threads())
+    ->UseRealTime();
+BENCHMARK(BM_expected)
+    ->RangeMultiplier(4)
+    ->Range(1, 256)
+    ->ArgName("depth")
+    ->ThreadRange(1, max_threads())
+    ->UseRealTime();
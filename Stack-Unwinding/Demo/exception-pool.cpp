@@ -0,0 +1,411 @@
+#include "exception-pool.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <typeinfo>
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <sys/mman.h>
+#include <unwind.h>
+
+#if defined(__ARM_EABI_UNWINDER__)
+#error "The exception header layout of the ARM EABI unwinder is not supported"
+#endif
+
+namespace
+{
+
+using exception_pool::SIZE_CLASS_COUNT;
+using exception_pool::SIZE_CLASSES;
+
+// The header that libstdc++ puts in front of every exception object, which
+// `__cxa_allocate_exception` must allocate and zero. This mirrors
+// `__cxa_exception` and `__cxa_refcounted_exception` in libsupc++'s
+// unwind-cxx.h, which is not installed.
+struct CxaException
+{
+  std::type_info *exceptionType;
+  void (*exceptionDestructor)(void *);
+  void (*unexpectedHandler)();
+  std::terminate_handler terminateHandler;
+  CxaException *nextException;
+  int handlerCount;
+  int handlerSwitchValue;
+  const unsigned char *actionRecord;
+  const unsigned char *languageSpecificData;
+  _Unwind_Ptr catchTemp;
+  void *adjustedPtr;
+  _Unwind_Exception unwindHeader;
+};
+
+struct CxaRefcountedException
+{
+  int referenceCount;
+  CxaException exc;
+};
+
+constexpr std::size_t HEADER_SIZE = sizeof(CxaRefcountedException);
+
+// Our own header in front of the runtime's header, which tells `free` the
+// size class of a block.
+struct alignas(alignof(CxaRefcountedException)) Prefix
+{
+  std::size_t size_class;
+};
+
+constexpr std::size_t OVERSIZED = SIZE_CLASS_COUNT;
+
+// The blocks are carved from one range of address space that is reserved at
+// the first use (the pages are only backed by memory when they are touched),
+// so `__cxa_free_exception` can tell our blocks from the runtime's by their
+// address, without reading anything outside the runtime's allocations.
+constexpr std::size_t ARENA_SIZE = std::size_t(1) << 30;
+
+// The number of blocks moved between a thread and the shared reserve at a
+// time, and the most blocks of one size class a thread keeps.
+constexpr std::size_t BATCH = 16;
+constexpr std::size_t MAX_CACHED = 4 * BATCH;
+
+// A free block links to the next free block in the space of the runtime's
+// header, which is zeroed when the block is allocated again.
+struct FreeBlock
+{
+  Prefix prefix;
+  FreeBlock *next;
+};
+
+std::size_t block_size(std::size_t size_class) noexcept
+{
+  return sizeof(Prefix) + HEADER_SIZE + SIZE_CLASSES[size_class];
+}
+
+std::size_t size_class_of(std::size_t thrown_size) noexcept
+{
+  for (std::size_t c = 0; c < SIZE_CLASS_COUNT; ++c)
+  {
+    if (thrown_size <= SIZE_CLASSES[c])
+    {
+      return c;
+    }
+  }
+  return OVERSIZED;
+}
+
+// The shared reserve of one size class.
+struct Reserve
+{
+  std::mutex mutex;
+  FreeBlock *head = nullptr;
+  std::size_t count = 0;
+  std::atomic<std::size_t> created{0};
+};
+
+Reserve g_reserves[SIZE_CLASS_COUNT];
+std::atomic<std::uint64_t> g_oversized{0};
+
+struct Arena
+{
+  char *base;
+  std::size_t size;
+  std::atomic<std::size_t> used{0};
+
+  Arena() noexcept
+  {
+    void *p = ::mmap(
+        nullptr,
+        ARENA_SIZE,
+        PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+        -1,
+        0);
+    base = (MAP_FAILED == p ? nullptr : static_cast<char *>(p));
+    size = (nullptr == base ? 0 : ARENA_SIZE);
+  }
+
+  bool contains(void const *p) const noexcept
+  {
+    const std::uintptr_t addr = reinterpret_cast<std::uintptr_t>(p);
+    const std::uintptr_t begin = reinterpret_cast<std::uintptr_t>(base);
+    return (addr >= begin && addr - begin < size);
+  }
+};
+
+Arena &arena() noexcept
+{
+  // Initialized on the first use, which may come before the constructors of
+  // this library run.
+  static Arena a;
+  return a;
+}
+
+FreeBlock *create_block(std::size_t size_class) noexcept
+{
+  Arena &a = arena();
+  const std::size_t size = block_size(size_class);
+  const std::size_t offset = a.used.fetch_add(size, std::memory_order_relaxed);
+  if (offset > a.size || a.size - offset < size)
+  {
+    // The arena is used up (or couldn't be reserved).
+    return nullptr;
+  }
+
+  FreeBlock *block = reinterpret_cast<FreeBlock *>(a.base + offset);
+  block->prefix.size_class = size_class;
+  block->next = nullptr;
+
+  g_reserves[size_class].created.fetch_add(1, std::memory_order_relaxed);
+  return block;
+}
+
+// Move up to `max` blocks from the list `head` to the reserve.
+void give_back(std::size_t size_class, FreeBlock *&head, std::size_t max)
+{
+  Reserve &reserve = g_reserves[size_class];
+  std::lock_guard<std::mutex> lock(reserve.mutex);
+
+  for (std::size_t i = 0; i < max && head != nullptr; ++i)
+  {
+    FreeBlock *block = head;
+    head = block->next;
+    block->next = reserve.head;
+    reserve.head = block;
+    ++reserve.count;
+  }
+}
+
+// The free lists of a thread. It is trivially destructible, so it can still
+// be used safely after `CacheReleaser` gives its blocks back at the thread's
+// exit (e.g., when a destructor of another thread-local object throws).
+struct Cache
+{
+  FreeBlock *head[SIZE_CLASS_COUNT];
+  std::size_t count[SIZE_CLASS_COUNT];
+  bool released;
+};
+
+// The initial-exec TLS model avoids a call of `__tls_get_addr` on every
+// access. It works because this library is loaded at startup (linked or
+// preloaded), not with `dlopen`.
+__attribute__((tls_model("initial-exec"))) thread_local Cache t_cache = {};
+
+class CacheReleaser
+{
+public:
+  ~CacheReleaser()
+  {
+    for (std::size_t c = 0; c < SIZE_CLASS_COUNT; ++c)
+    {
+      give_back(c, t_cache.head[c], t_cache.count[c]);
+      t_cache.count[c] = 0;
+    }
+    t_cache.released = true;
+  }
+
+  void touch() noexcept
+  {
+    // Using the object makes sure its destructor is registered.
+  }
+};
+
+__attribute__((tls_model("initial-exec"))) thread_local CacheReleaser
+    t_releaser;
+
+FreeBlock *allocate_block(std::size_t size_class) noexcept
+{
+  Cache &cache = t_cache;
+
+  if (nullptr == cache.head[size_class] && !cache.released)
+  {
+    t_releaser.touch();
+
+    // Refill a batch from the reserve.
+    Reserve &reserve = g_reserves[size_class];
+    std::lock_guard<std::mutex> lock(reserve.mutex);
+    for (std::size_t i = 0; i < BATCH && reserve.head != nullptr; ++i)
+    {
+      FreeBlock *block = reserve.head;
+      reserve.head = block->next;
+      --reserve.count;
+      block->next = cache.head[size_class];
+      cache.head[size_class] = block;
+      ++cache.count[size_class];
+    }
+  }
+
+  if (FreeBlock *block = cache.head[size_class])
+  {
+    cache.head[size_class] = block->next;
+    --cache.count[size_class];
+    return block;
+  }
+
+  if (cache.released)
+  {
+    Reserve &reserve = g_reserves[size_class];
+    std::lock_guard<std::mutex> lock(reserve.mutex);
+    if (FreeBlock *block = reserve.head)
+    {
+      reserve.head = block->next;
+      --reserve.count;
+      return block;
+    }
+  }
+
+  return create_block(size_class);
+}
+
+void free_block(FreeBlock *block) noexcept
+{
+  const std::size_t size_class = block->prefix.size_class;
+  Cache &cache = t_cache;
+
+  if (cache.released)
+  {
+    block->next = nullptr;
+    give_back(size_class, block, 1);
+    return;
+  }
+
+  // A thread may only free exceptions that other threads allocated (e.g.,
+  // when it drops an `exception_ptr`), so it registers its cleanup here too.
+  t_releaser.touch();
+
+  block->next = cache.head[size_class];
+  cache.head[size_class] = block;
+  ++cache.count[size_class];
+
+  if (cache.count[size_class] > MAX_CACHED)
+  {
+    give_back(size_class, cache.head[size_class], BATCH);
+    cache.count[size_class] -= BATCH;
+  }
+}
+
+__attribute__((constructor)) void reserve_from_environment()
+{
+  if (char const *count = std::getenv("EXCEPTION_POOL_RESERVE"))
+  {
+    exception_pool::reserve(std::strtoul(count, nullptr, 10));
+  }
+}
+
+} // namespace
+
+namespace __cxxabiv1
+{
+
+extern "C" {
+
+void *__cxa_allocate_exception(std::size_t thrown_size) noexcept
+{
+  const std::size_t size_class = size_class_of(thrown_size);
+
+  FreeBlock *block = nullptr;
+  if (OVERSIZED == size_class)
+  {
+    g_oversized.fetch_add(1, std::memory_order_relaxed);
+  }
+  else
+  {
+    block = allocate_block(size_class);
+  }
+
+  if (nullptr == block)
+  {
+    // Too big for the pool, or the arena is used up: let the runtime
+    // allocate it (with `malloc`, or from its emergency pool).
+    using Fn = void *(*)(std::size_t);
+    static Fn const real =
+        reinterpret_cast<Fn>(::dlsym(RTLD_NEXT, "__cxa_allocate_exception"));
+    if (nullptr == real)
+    {
+      // This is what the C++ ABI requires when the exception can't be
+      // allocated.
+      std::terminate();
+    }
+    return real(thrown_size);
+  }
+
+  char *header = reinterpret_cast<char *>(&block->prefix + 1);
+  std::memset(header, 0, HEADER_SIZE);
+  return header + HEADER_SIZE;
+}
+
+void __cxa_free_exception(void *vptr) noexcept
+{
+  if (!arena().contains(vptr))
+  {
+    // Not allocated by us (e.g., too big, or allocated by the runtime before
+    // this library was loaded), so let the runtime free it.
+    using Fn = void (*)(void *);
+    static Fn const real =
+        reinterpret_cast<Fn>(::dlsym(RTLD_NEXT, "__cxa_free_exception"));
+    if (real != nullptr)
+    {
+      real(vptr);
+    }
+    return;
+  }
+
+  char *header = static_cast<char *>(vptr) - HEADER_SIZE;
+  Prefix *prefix = reinterpret_cast<Prefix *>(header) - 1;
+  free_block(reinterpret_cast<FreeBlock *>(prefix));
+}
+
+} // extern "C"
+
+} // namespace __cxxabiv1
+
+namespace exception_pool
+{
+
+bool reserve(std::size_t count) noexcept
+{
+  // Register the calling thread's cleanup now rather than on its first
+  // throw, which may happen when memory is low.
+  t_releaser.touch();
+
+  for (std::size_t c = 0; c < SIZE_CLASS_COUNT; ++c)
+  {
+    Reserve &reserve = g_reserves[c];
+    std::lock_guard<std::mutex> lock(reserve.mutex);
+
+    while (reserve.count < count)
+    {
+      FreeBlock *block = create_block(c);
+      if (nullptr == block)
+      {
+        return false;
+      }
+
+      block->next = reserve.head;
+      reserve.head = block;
+      ++reserve.count;
+    }
+  }
+
+  return true;
+}
+
+Stats stats() noexcept
+{
+  Stats s = {};
+
+  for (std::size_t c = 0; c < SIZE_CLASS_COUNT; ++c)
+  {
+    Reserve &reserve = g_reserves[c];
+    s.created[c] = reserve.created.load(std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(reserve.mutex);
+    s.reserved[c] = reserve.count;
+  }
+  s.oversized = g_oversized.load(std::memory_order_relaxed);
+
+  return s;
+}
+
+} // namespace exception_pool
@@ -0,0 +1,65 @@
+#pragma once
+
+// An opt-in allocator for exception objects.
+//
+// Every `throw` expression first calls the C++ ABI function
+// `__cxa_allocate_exception` to allocate the exception object (plus the
+// runtime's header in front of it). libstdc++ allocates it with `malloc` and,
+// when `malloc` fails, from a small emergency pool that is protected by a
+// global mutex. So throwing can fail (which ends in `std::terminate`) when
+// memory is low, and it contends on the allocator when many threads throw.
+//
+// Linking this library into a program (or loading it with `LD_PRELOAD`)
+// replaces `__cxa_allocate_exception` and `__cxa_free_exception` with a pool:
+//
+// - Exception objects are grouped into size classes (up to
+//   `MAX_POOLED_SIZE` bytes). Larger ones are allocated by the runtime.
+// - The blocks are carved from a range of address space that is reserved up
+//   front, which tells them apart from the runtime's allocations.
+// - Each thread keeps its own free list per size class, so allocating and
+//   freeing do not take any lock in the common case.
+// - The threads refill and drain their free lists in batches from a shared
+//   reserve, which is the only place with a lock.
+// - The reserve can be filled in advance with `reserve()` (or the
+//   `EXCEPTION_POOL_RESERVE` environment variable, read at load time), so
+//   exceptions can still be thrown when memory is low.
+//
+// The memory of the pool is never returned to the system.
+
+#include <cstddef>
+#include <cstdint>
+
+namespace exception_pool
+{
+
+// The size classes of the exception objects (without the runtime's header).
+constexpr std::size_t SIZE_CLASSES[] = {64, 128, 256, 512, 1024, 2048};
+constexpr std::size_t SIZE_CLASS_COUNT =
+    sizeof(SIZE_CLASSES) / sizeof(SIZE_CLASSES[0]);
+constexpr std::size_t MAX_POOLED_SIZE = SIZE_CLASSES[SIZE_CLASS_COUNT - 1];
+
+struct Stats
+{
+  // The number of blocks created for each size class so far.
+  std::size_t created[SIZE_CLASS_COUNT];
+
+  // The number of blocks in the shared reserve for each size class, which
+  // does not include the blocks cached by the threads.
+  std::size_t reserved[SIZE_CLASS_COUNT];
+
+  // The number of exception objects larger than `MAX_POOLED_SIZE`, which are
+  // allocated by the runtime.
+  std::uint64_t oversized;
+};
+
+// Add blocks to the shared reserve until it holds at least `count` blocks of
+// each size class.
+//
+// Returns false if out of memory, in which case the reserve may be partially
+// filled.
+bool reserve(std::size_t count) noexcept;
+
+// Return the statistics of the pool.
+Stats stats() noexcept;
+
+} // namespace exception_pool
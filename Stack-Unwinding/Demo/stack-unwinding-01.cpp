@@ -12,7 +12,7 @@ public:
 
 public:
   // Default constructor.
-  constexpr MyExcept(CopyThrows copy_throws) noexcept;
+  MyExcept(CopyThrows copy_throws) noexcept;
 
   // Copy constructor that may throw exceptions.
   MyExcept(MyExcept const &other) noexcept(false);
@@ -27,7 +27,7 @@ private:
   CopyThrows _copy_throws;
 };
 
-constexpr MyExcept::MyExcept(CopyThrows copy_throws) noexcept
+MyExcept::MyExcept(CopyThrows copy_throws) noexcept
     : _copy_throws(copy_throws)
 {
   std::cout << "Calling MyExcept::MyExcept()" << std::endl;
@@ -63,7 +63,7 @@ void MyExcept::_copy(MyExcept const &other) noexcept(false)
 class A
 {
 public:
-  constexpr A() noexcept
+  A() noexcept
   {
     std::cout << "Calling A::A()" << std::endl;
   }
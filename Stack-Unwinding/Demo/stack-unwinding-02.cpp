@@ -12,7 +12,7 @@ public:
 
 public:
   // Default constructor.
-  constexpr MyExcept(CopyThrows copy_throws) noexcept;
+  MyExcept(CopyThrows copy_throws) noexcept;
 
   // Copy constructor that may throw exceptions.
   MyExcept(MyExcept const &other) noexcept(false);
@@ -27,7 +27,7 @@ private:
   CopyThrows _copy_throws;
 };
 
-constexpr MyExcept::MyExcept(CopyThrows copy_throws) noexcept
+MyExcept::MyExcept(CopyThrows copy_throws) noexcept
     : _copy_throws(copy_throws)
 {
   std::cout << "Calling MyExcept::MyExcept()" << std::endl;
@@ -70,7 +70,7 @@ public:
   };
 
 public:
-  constexpr A(DestructorThrows destruct_throws) noexcept;
+  A(DestructorThrows destruct_throws) noexcept;
 
   A(A const &) = delete;
   A &operator=(A const &) = delete;
@@ -81,7 +81,7 @@ private:
   DestructorThrows _destruct_throws;
 };
 
-constexpr A::A(DestructorThrows destruct_throws) noexcept
+A::A(DestructorThrows destruct_throws) noexcept
     : _destruct_throws(destruct_throws)
 {
   std::cout << "Calling A::A()" << std::endl;
@@ -0,0 +1,156 @@
+// Throw exceptions while `malloc` fails, with the exception objects allocated
+// from `exception_pool`'s reserve.
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "exception-pool.hpp"
+
+// Simulate out-of-memory: `malloc` fails while `g_out_of_memory` is true.
+extern "C" void *__libc_malloc(std::size_t size);
+
+std::atomic<bool> g_out_of_memory{false};
+
+extern "C" void *malloc(std::size_t size)
+{
+  if (g_out_of_memory.load(std::memory_order_relaxed))
+  {
+    return nullptr;
+  }
+  return __libc_malloc(size);
+}
+
+class MyExcept
+{
+public:
+  MyExcept(int depth) noexcept : _depth(depth)
+  {
+  }
+
+  int depth() const noexcept
+  {
+    return _depth;
+  }
+
+private:
+  int _depth;
+  char _payload[200];
+};
+
+class A
+{
+public:
+  A() noexcept
+  {
+  }
+
+  A(A const &) = delete;
+  A &operator=(A const &) = delete;
+
+  ~A() noexcept
+  {
+  }
+};
+
+// Throw `MyExcept` and, in its handler, recurse to throw another one, so
+// `depth` exceptions are alive at the same time.
+int throw_nested(int depth)
+{
+  try
+  {
+    A a;
+    throw MyExcept(depth);
+  }
+  catch (MyExcept const &e)
+  {
+    if (depth > 1)
+    {
+      return throw_nested(depth - 1) + 1;
+    }
+    return 1;
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  const int NESTED = 32;
+  const int THREADS = 4;
+  const int THROWS_PER_THREAD = 10000;
+
+  if (!exception_pool::reserve(NESTED * (THREADS + 1)))
+  {
+    std::cout << "Failed to reserve the exception objects." << std::endl;
+    return 1;
+  }
+
+  // Start the threads before running out of memory.
+  std::atomic<int> handled{0};
+  std::vector<std::thread> threads;
+  for (int i = 0; i < THREADS; ++i)
+  {
+    threads.emplace_back([&handled]() {
+      while (!g_out_of_memory.load())
+      {
+        std::this_thread::yield();
+      }
+
+      int n = 0;
+      for (int i = 0; i < THROWS_PER_THREAD; ++i)
+      {
+        try
+        {
+          throw MyExcept(i);
+        }
+        catch (MyExcept const &e)
+        {
+          ++n;
+        }
+      }
+      n += throw_nested(NESTED);
+      handled += n;
+    });
+  }
+
+  std::cout << "Running out of memory..." << std::endl;
+  g_out_of_memory.store(true);
+
+  bool ok = (nullptr == std::malloc(1));
+
+  try
+  {
+    A a1;
+
+    throw MyExcept(0);
+
+    A a2;
+  }
+  catch (MyExcept const &e)
+  {
+    std::cout << "Handling exception of type `MyExcept`..." << std::endl;
+    std::cout << "Exception is handled." << std::endl;
+  }
+
+  ok = ok && (NESTED == throw_nested(NESTED));
+
+  for (std::thread &t : threads)
+  {
+    t.join();
+  }
+
+  g_out_of_memory.store(false);
+
+  ok = ok && ((THROWS_PER_THREAD + NESTED) * THREADS == handled.load());
+
+  const exception_pool::Stats stats = exception_pool::stats();
+  for (std::size_t c = 0; c < exception_pool::SIZE_CLASS_COUNT; ++c)
+  {
+    std::cout << "Size class " << exception_pool::SIZE_CLASSES[c]
+              << ": created = " << stats.created[c]
+              << ", reserved = " << stats.reserved[c] << std::endl;
+  }
+
+  std::cout << (ok ? "OK" : "FAILED") << std::endl;
+  return (ok ? 0 : 1);
+}
@@ -0,0 +1,143 @@
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <unistd.h>
+
+#include "throw-telemetry.hpp"
+
+class MyExcept
+{
+};
+
+// Return the demangled name of `type`.
+std::string demangle(std::type_info const *type)
+{
+  if (nullptr == type)
+  {
+    return "(other types)";
+  }
+
+  int status = 0;
+  std::unique_ptr<char, void (*)(void *)> name(
+      abi::__cxa_demangle(type->name(), nullptr, nullptr, &status), std::free);
+  return (0 == status ? name.get() : type->name());
+}
+
+// Check if `addr` is in the same shared object as `other`.
+bool same_object(void const *addr, void const *other)
+{
+  Dl_info a = {};
+  Dl_info b = {};
+  return (::dladdr(addr, &a) != 0 && ::dladdr(other, &b) != 0 &&
+          a.dli_fbase == b.dli_fbase);
+}
+
+void throw_and_catch(int n)
+{
+  for (int i = 0; i < n; ++i)
+  {
+    try
+    {
+      throw std::runtime_error("runtime_error");
+    }
+    catch (std::exception const &e)
+    {
+    }
+
+    try
+    {
+      throw MyExcept();
+    }
+    catch (MyExcept const &e)
+    {
+    }
+
+    try
+    {
+      throw MyExcept();
+    }
+    catch (...)
+    {
+    }
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  const int THREADS = 4;
+  const int N = 1000;
+
+  throw_telemetry::set_sample_period(500);
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < THREADS; ++i)
+  {
+    threads.emplace_back(throw_and_catch, N);
+  }
+  for (std::thread &t : threads)
+  {
+    t.join();
+  }
+
+  // The blocks of the exited threads are reused.
+  std::thread(throw_and_catch, N).join();
+
+  const throw_telemetry::Snapshot s = throw_telemetry::take_snapshot();
+
+  std::cout << "Throws: " << s.throws << std::endl;
+  std::cout << "Catches: " << s.catches << std::endl;
+
+  std::cout << "Throws by type:" << std::endl;
+  for (throw_telemetry::TypeCount const &tc : s.types)
+  {
+    std::cout << "  " << demangle(tc.type) << ": " << tc.count << std::endl;
+  }
+
+  std::cout << "Throw-to-catch latency:" << std::endl;
+  for (std::size_t i = 0; i < throw_telemetry::HISTOGRAM_BUCKETS; ++i)
+  {
+    if (s.latency_ns_histogram[i] > 0)
+    {
+      std::cout << "  < " << (1ULL << i) << " ns: " << s.latency_ns_histogram[i]
+                << std::endl;
+    }
+  }
+
+  std::cout << "Samples: " << s.samples.size() << std::endl;
+  if (!s.samples.empty())
+  {
+    throw_telemetry::Sample const &sample = s.samples.front();
+    std::cout << "Throw site of a " << demangle(sample.type) << ":"
+              << std::endl;
+    ::backtrace_symbols_fd(
+        sample.frames, static_cast<int>(sample.depth), STDOUT_FILENO);
+  }
+
+  // Check the counts so this demo also works as a test.
+  const std::uint64_t expected = 3ULL * N * (THREADS + 1);
+  bool ok = (expected == s.throws && expected == s.catches &&
+             2 == s.types.size() && s.types[0].count == 2 * expected / 3 &&
+             typeid(MyExcept) == *s.types[0].type &&
+             typeid(std::runtime_error) == *s.types[1].type &&
+             !s.samples.empty());
+
+  // The samples start at the throw site, not inside the telemetry library.
+  for (throw_telemetry::Sample const &sample : s.samples)
+  {
+    ok = ok && sample.depth > 0 &&
+         !same_object(
+             sample.frames[0],
+             reinterpret_cast<void const *>(&throw_telemetry::take_snapshot));
+  }
+
+  std::cout << (ok ? "OK" : "FAILED") << std::endl;
+  return (ok ? 0 : 1);
+}
@@ -0,0 +1,378 @@
+#include "throw-telemetry.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+
+namespace
+{
+
+using throw_telemetry::HISTOGRAM_BUCKETS;
+using throw_telemetry::MAX_FRAMES;
+
+// The number of exception types each thread can count separately. Must be a
+// power of 2.
+constexpr std::size_t TYPE_SLOTS = 64;
+
+// The number of the most recent samples each thread keeps.
+constexpr std::size_t SAMPLE_SLOTS = 8;
+
+// All the counters below are written by only one thread (the owner of the
+// `Block`) and read by `take_snapshot()` on any thread. They are atomic only
+// so the concurrent reads are well-defined: the owner updates them with a
+// relaxed load and store, which compiles to plain instructions, instead of a
+// read-modify-write.
+void bump(std::atomic<std::uint64_t> &counter) noexcept
+{
+  counter.store(
+      counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+struct TypeSlot
+{
+  std::atomic<std::type_info const *> type{nullptr};
+  std::atomic<std::uint64_t> count{0};
+};
+
+// A sample is written under a sequence lock: `seq` is odd while the sample
+// is being written, so the reader can tell a torn sample and skip it.
+struct SampleSlot
+{
+  std::atomic<std::uint32_t> seq{0};
+  std::atomic<std::type_info const *> type{nullptr};
+  std::atomic<std::size_t> depth{0};
+  std::atomic<void *> frames[MAX_FRAMES] = {};
+};
+
+// The counters of one thread. The blocks are never freed: when a thread
+// exits, its block is released to be reused by a new thread, which keeps
+// adding to the same counters.
+struct Block
+{
+  std::atomic<bool> in_use{true};
+  Block *next = nullptr;
+
+  std::atomic<std::uint64_t> throws{0};
+  std::atomic<std::uint64_t> catches{0};
+  std::atomic<std::uint64_t> other_types{0};
+  TypeSlot types[TYPE_SLOTS];
+  std::atomic<std::uint64_t> histogram[HISTOGRAM_BUCKETS] = {};
+  SampleSlot samples[SAMPLE_SLOTS];
+  std::atomic<std::uint64_t> sample_count{0};
+
+  // Only used by the owner.
+  std::uint32_t throws_since_sample = 0;
+  bool pending = false;
+  std::chrono::steady_clock::time_point thrown_at;
+};
+
+std::atomic<Block *> g_blocks{nullptr};
+std::atomic<std::uint32_t> g_sample_period{0};
+
+Block *acquire_block() noexcept
+{
+  for (Block *b = g_blocks.load(std::memory_order_acquire); b != nullptr;
+       b = b->next)
+  {
+    bool in_use = false;
+    if (b->in_use.compare_exchange_strong(
+            in_use, true, std::memory_order_acquire))
+    {
+      return b;
+    }
+  }
+
+  // Under memory pressure, the thread is simply not counted.
+  Block *b = new (std::nothrow) Block();
+  if (nullptr == b)
+  {
+    return nullptr;
+  }
+
+  b->next = g_blocks.load(std::memory_order_relaxed);
+  while (!g_blocks.compare_exchange_weak(
+      b->next, b, std::memory_order_release, std::memory_order_relaxed))
+  {
+    // Retry with the new head.
+  }
+
+  return b;
+}
+
+// Releases the thread's block when the thread exits.
+class Owner
+{
+public:
+  ~Owner() noexcept
+  {
+    if (_block != nullptr)
+    {
+      _block->pending = false;
+      _block->in_use.store(false, std::memory_order_release);
+    }
+  }
+
+  Block *block() noexcept
+  {
+    if (nullptr == _block)
+    {
+      _block = acquire_block();
+    }
+    return _block;
+  }
+
+private:
+  Block *_block = nullptr;
+};
+
+thread_local Owner t_owner;
+
+void count_type(Block &b, std::type_info const *type) noexcept
+{
+  const std::size_t hash = reinterpret_cast<std::uintptr_t>(type) >> 4;
+
+  for (std::size_t i = 0; i < TYPE_SLOTS; ++i)
+  {
+    TypeSlot &slot = b.types[(hash + i) & (TYPE_SLOTS - 1)];
+
+    std::type_info const *t = slot.type.load(std::memory_order_relaxed);
+    if (nullptr == t)
+    {
+      slot.type.store(type, std::memory_order_release);
+      t = type;
+    }
+
+    if (t == type)
+    {
+      bump(slot.count);
+      return;
+    }
+  }
+
+  bump(b.other_types);
+}
+
+// Not inlined, so the frames to skip below are known.
+__attribute__((noinline)) void sample(
+    Block &b, std::type_info const *type) noexcept
+{
+  const std::uint32_t period = g_sample_period.load(std::memory_order_relaxed);
+  if (0 == period || ++b.throws_since_sample < period)
+  {
+    return;
+  }
+  b.throws_since_sample = 0;
+
+  // Frame 0 is `sample` itself and frame 1 is `__cxa_throw`.
+  constexpr int SKIPPED_FRAMES = 2;
+  void *frames[MAX_FRAMES + SKIPPED_FRAMES];
+  const int n =
+      ::backtrace(frames, static_cast<int>(MAX_FRAMES + SKIPPED_FRAMES));
+  const std::size_t depth =
+      (n > SKIPPED_FRAMES ? static_cast<std::size_t>(n - SKIPPED_FRAMES) : 0);
+
+  const std::uint64_t index = b.sample_count.load(std::memory_order_relaxed);
+  SampleSlot &slot = b.samples[index % SAMPLE_SLOTS];
+
+  const std::uint32_t seq = slot.seq.load(std::memory_order_relaxed);
+  slot.seq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  slot.type.store(type, std::memory_order_relaxed);
+  slot.depth.store(depth, std::memory_order_relaxed);
+  for (std::size_t i = 0; i < depth; ++i)
+  {
+    slot.frames[i].store(frames[i + SKIPPED_FRAMES], std::memory_order_relaxed);
+  }
+
+  slot.seq.store(seq + 2, std::memory_order_release);
+  b.sample_count.store(index + 1, std::memory_order_release);
+}
+
+std::size_t histogram_bucket(std::chrono::steady_clock::duration latency)
+{
+  const auto ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count();
+  if (ns <= 0)
+  {
+    return 0;
+  }
+
+  const std::size_t bucket = static_cast<std::size_t>(
+      64 - __builtin_clzll(static_cast<unsigned long long>(ns)));
+  return std::min(bucket, HISTOGRAM_BUCKETS - 1);
+}
+
+// Look up the next definition of `name` (i.e., the one in the C++ runtime).
+template <typename Fn>
+Fn next_symbol(char const *name) noexcept
+{
+  void *sym = ::dlsym(RTLD_NEXT, name);
+  if (nullptr == sym)
+  {
+    // Nothing can be thrown or caught without it.
+    std::abort();
+  }
+  return reinterpret_cast<Fn>(sym);
+}
+
+} // namespace
+
+namespace __cxxabiv1
+{
+
+extern "C" {
+
+void __cxa_throw(void *obj, std::type_info *tinfo, void (*dest)(void *))
+{
+  using Fn = void (*)(void *, std::type_info *, void (*)(void *));
+  static Fn const real = next_symbol<Fn>("__cxa_throw");
+
+  if (Block *b = t_owner.block())
+  {
+    bump(b->throws);
+    count_type(*b, tinfo);
+    sample(*b, tinfo);
+
+    // Take the time last so it doesn't include the telemetry itself.
+    b->pending = true;
+    b->thrown_at = std::chrono::steady_clock::now();
+  }
+
+  real(obj, tinfo, dest);
+  __builtin_unreachable();
+}
+
+void *__cxa_begin_catch(void *exc) noexcept
+{
+  using Fn = void *(*)(void *);
+  static Fn const real = next_symbol<Fn>("__cxa_begin_catch");
+
+  const auto now = std::chrono::steady_clock::now();
+
+  if (Block *b = t_owner.block())
+  {
+    bump(b->catches);
+    if (b->pending)
+    {
+      b->pending = false;
+      bump(b->histogram[histogram_bucket(now - b->thrown_at)]);
+    }
+  }
+
+  return real(exc);
+}
+
+} // extern "C"
+
+} // namespace __cxxabiv1
+
+namespace throw_telemetry
+{
+
+Snapshot take_snapshot()
+{
+  Snapshot snapshot = {};
+
+  for (Block *b = g_blocks.load(std::memory_order_acquire); b != nullptr;
+       b = b->next)
+  {
+    snapshot.throws += b->throws.load(std::memory_order_relaxed);
+    snapshot.catches += b->catches.load(std::memory_order_relaxed);
+
+    for (std::size_t i = 0; i < HISTOGRAM_BUCKETS; ++i)
+    {
+      snapshot.latency_ns_histogram[i] +=
+          b->histogram[i].load(std::memory_order_relaxed);
+    }
+
+    // The same type may be counted by many threads, and may even have more
+    // than one `type_info` object when it is thrown from different shared
+    // libraries, so the types are merged by `type_info` equality.
+    auto add = [&snapshot](std::type_info const *type, std::uint64_t count) {
+      for (TypeCount &tc : snapshot.types)
+      {
+        if (tc.type == type ||
+            (tc.type != nullptr && type != nullptr && *tc.type == *type))
+        {
+          tc.count += count;
+          return;
+        }
+      }
+      snapshot.types.push_back(TypeCount{type, count});
+    };
+
+    for (TypeSlot const &slot : b->types)
+    {
+      std::type_info const *type = slot.type.load(std::memory_order_acquire);
+      const std::uint64_t count = slot.count.load(std::memory_order_relaxed);
+      if (type != nullptr && count > 0)
+      {
+        add(type, count);
+      }
+    }
+
+    const std::uint64_t other = b->other_types.load(std::memory_order_relaxed);
+    if (other > 0)
+    {
+      add(nullptr, other);
+    }
+
+    const std::uint64_t samples = std::min<std::uint64_t>(
+        b->sample_count.load(std::memory_order_acquire), SAMPLE_SLOTS);
+    for (std::size_t i = 0; i < samples; ++i)
+    {
+      SampleSlot const &slot = b->samples[i];
+
+      const std::uint32_t seq = slot.seq.load(std::memory_order_acquire);
+      if (seq % 2 != 0)
+      {
+        continue; // Being written.
+      }
+
+      Sample sample = {};
+      sample.type = slot.type.load(std::memory_order_relaxed);
+      sample.depth = slot.depth.load(std::memory_order_relaxed);
+      for (std::size_t j = 0; j < sample.depth; ++j)
+      {
+        sample.frames[j] = slot.frames[j].load(std::memory_order_relaxed);
+      }
+
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.seq.load(std::memory_order_relaxed) != seq)
+      {
+        continue; // Overwritten while being read.
+      }
+
+      snapshot.samples.push_back(sample);
+    }
+  }
+
+  std::sort(
+      snapshot.types.begin(),
+      snapshot.types.end(),
+      [](TypeCount const &a, TypeCount const &b) { return a.count > b.count; });
+
+  return snapshot;
+}
+
+void set_sample_period(std::uint32_t period) noexcept
+{
+  if (period > 0)
+  {
+    // The first call of `backtrace` loads libgcc, which allocates memory, so
+    // do it now rather than in the middle of a throw.
+    void *frame = nullptr;
+    ::backtrace(&frame, 1);
+  }
+
+  g_sample_period.store(period, std::memory_order_relaxed);
+}
+
+} // namespace throw_telemetry
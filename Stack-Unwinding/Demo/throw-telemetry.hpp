@@ -0,0 +1,85 @@
+#pragma once
+
+// Process-wide telemetry of thrown and caught exceptions.
+//
+// Linking this library into a program (or loading it with `LD_PRELOAD`)
+// interposes the C++ ABI functions `__cxa_throw` and `__cxa_begin_catch`,
+// which every `throw` expression and every `catch` clause call, and forwards
+// them to the C++ runtime after recording:
+//
+// - The number of throws per exception type.
+// - The latency from the throw to the catch (i.e., the time spent on
+//   unwinding the stack), as a histogram.
+// - Optionally, the backtraces of a sample of the throw sites.
+//
+// The counters are kept per thread and updated without locks or atomic
+// read-modify-write instructions. Nothing is done until an exception is
+// thrown, so a program that does not throw pays nothing.
+//
+// Limitations:
+// - Rethrowing (`throw;` and `std::rethrow_exception`) is not counted as a
+//   throw, but the following catch is still counted.
+// - If an exception is thrown and caught inside a destructor during the
+//   unwinding of another exception, the latency of the outer exception is
+//   not recorded.
+
+#include <cstddef>
+#include <cstdint>
+#include <typeinfo>
+#include <vector>
+
+namespace throw_telemetry
+{
+
+// The number of buckets of the latency histogram. Bucket 0 counts the
+// latencies of 0 ns; bucket `i` (i > 0) counts the latencies in
+// [2^(i-1), 2^i) ns; the last bucket also counts all the longer ones.
+constexpr std::size_t HISTOGRAM_BUCKETS = 40;
+
+// The maximum number of frames of a sampled backtrace.
+constexpr std::size_t MAX_FRAMES = 32;
+
+// The number of throws of one exception type.
+struct TypeCount
+{
+  // `nullptr` counts the throws whose types didn't fit in the per-thread
+  // tables.
+  std::type_info const *type;
+  std::uint64_t count;
+};
+
+// The backtrace of a sampled throw site.
+struct Sample
+{
+  std::type_info const *type;
+  std::size_t depth;
+  void *frames[MAX_FRAMES];
+};
+
+struct Snapshot
+{
+  std::uint64_t throws;
+  std::uint64_t catches;
+
+  // Sorted by `count` in descending order.
+  std::vector<TypeCount> types;
+
+  std::uint64_t latency_ns_histogram[HISTOGRAM_BUCKETS];
+
+  // The most recent samples of each thread.
+  std::vector<Sample> samples;
+};
+
+// Take a snapshot of the counters of all the threads (including the threads
+// that have exited). The threads that are throwing at the same time are not
+// blocked, so the snapshot may miss their latest throws.
+//
+// Throws:
+// - `std::bad_alloc`: When out of memory.
+Snapshot take_snapshot();
+
+// Capture the backtrace of every `period`th throw of each thread. 0 (the
+// default) disables sampling.
+void set_sample_period(std::uint32_t period) noexcept;
+
+} // namespace throw_telemetry